@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <vector>
+using namespace std;
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+arena::arena(): next (nullptr), limit (nullptr), used_bytes (0) {
+}
+
+arena::~arena() {
+   for (char* block: blocks) free (block);
+   for (char* block: large_blocks) free (block);
+}
+
+static char* align_up (char* pointer, size_t align) {
+   uintptr_t address = reinterpret_cast<uintptr_t> (pointer);
+   address = (address + align - 1) & ~(uintptr_t (align) - 1);
+   return reinterpret_cast<char*> (address);
+}
+
+void* arena::allocate (size_t size, size_t align) {
+   used_bytes += size;
+   char* start = align_up (next, align);
+   if (next != nullptr and start + size <= limit) {
+      next = start + size;
+      return start;
+   }
+   return allocate_block (size, align);
+}
+
+//Starts a new block, of the usual size unless size will not fit
+//in one.  An oversized block holds only this allocation, and
+//bumping goes on in the block that was current.
+void* arena::allocate_block (size_t size, size_t align) {
+   size_t length = max (size + align, BLOCK_SIZE);
+   char* block = static_cast<char*> (malloc (length));
+   if (block == nullptr) throw bad_alloc();
+   char* start = align_up (block, align);
+   if (length > BLOCK_SIZE) {
+      large_blocks.push_back (block);
+      return start;
+   }
+   blocks.push_back (block);
+   next = start + size;
+   limit = block + BLOCK_SIZE;
+   return start;
+}
+
+void arena::reset() {
+   for (char* block: large_blocks) free (block);
+   large_blocks.clear();
+   used_bytes = 0;
+   if (blocks.empty()) return;
+   for (size_t block = 1; block < blocks.size(); ++block) {
+      free (blocks[block]);
+   }
+   blocks.resize (1);
+   next = blocks.front();
+   limit = next + BLOCK_SIZE;
+}
@@ -0,0 +1,78 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <cstddef>
+#include <vector>
+using namespace std;
+
+//
+// DESCRIPTION
+//    A bump allocator.  Memory is handed out from large blocks in
+//    the order it is asked for, and is never freed piece by piece:
+//    reset releases all of it at once, keeping the first block for
+//    the next use.  Nothing allocated in an arena is destroyed, so
+//    only objects that need no destructor belong in one.
+//
+
+struct arena {
+   static constexpr size_t BLOCK_SIZE = size_t (1) << 18;
+
+   arena();
+   ~arena();
+   arena (const arena&) = delete;
+   arena& operator= (const arena&) = delete;
+
+   void* allocate (size_t size, size_t align = alignof (max_align_t));
+   void reset();
+   size_t used() const { return used_bytes; }
+   // Bytes handed out since the last reset.
+
+   private:
+   vector<char*> blocks;
+   vector<char*> large_blocks;  // each bigger than BLOCK_SIZE
+   char* next;
+   char* limit;
+   size_t used_bytes;
+   void* allocate_block (size_t size, size_t align);
+};
+
+//
+// Lets a standard container take its storage from an arena.  With
+// no arena it uses the heap, and then frees what it is given back.
+//
+
+template <typename item_t>
+struct arena_allocator {
+   using value_type = item_t;
+   arena* owner;
+
+   arena_allocator (arena* owner_) noexcept: owner (owner_) {}
+   template <typename other_t>
+   arena_allocator (const arena_allocator<other_t>& other) noexcept:
+                    owner (other.owner) {}
+
+   item_t* allocate (size_t count) {
+      size_t size = count * sizeof (item_t);
+      void* memory = owner == nullptr ? ::operator new (size)
+                   : owner->allocate (size, alignof (item_t));
+      return static_cast<item_t*> (memory);
+   }
+   void deallocate (item_t* memory, size_t) noexcept {
+      if (owner == nullptr) ::operator delete (memory);
+   }
+};
+
+template <typename left_t, typename right_t>
+bool operator== (const arena_allocator<left_t>& left,
+                 const arena_allocator<right_t>& right) {
+   return left.owner == right.owner;
+}
+
+template <typename left_t, typename right_t>
+bool operator!= (const arena_allocator<left_t>& left,
+                 const arena_allocator<right_t>& right) {
+   return left.owner != right.owner;
+}
+
+#endif
+
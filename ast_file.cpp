@@ -0,0 +1,221 @@
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ast_file.h"
+#include "astree.h"
+#include "auxlib.h"
+#include "string_set.h"
+
+static const char MAGIC[4] {'O', 'C', 'A', 'B'};
+
+template <typename item_t>
+static void append (vector<char>& image, const item_t* items,
+                    size_t count) {
+   const char* bytes = reinterpret_cast<const char*> (items);
+   image.insert (image.end(), bytes, bytes + count * sizeof *items);
+}
+
+ast_file::writer::writer (const vector<string>& filenames_):
+                  filenames (filenames_), root (nullptr) {
+}
+
+uint32_t ast_file::writer::number (const interned* text) {
+   if (text->id >= numbers.size()) numbers.resize (text->id + 1);
+   uint32_t& number = numbers[text->id];
+   if (number == 0) {
+      strings.push_back (text->view());
+      number = strings.size();
+   }
+   return number - 1;
+}
+
+bool ast_file::writer::pre_node (astree* tree, int) {
+   if (root == nullptr) root = tree;
+   uint32_t record = nodes.size();
+   walking.push_back (record);
+   uint32_t first = tree->children.empty() ? 0 : record + 1;
+   nodes.push_back ({tree->symbol, tree->lloc.filenr,
+                     tree->lloc.linenr, tree->lloc.offset,
+                     number (tree->lexinfo), first, 0});
+   return true;
+}
+
+// A sibling is the next node in preorder after the subtree.
+void ast_file::writer::post_node (astree* tree) {
+   uint32_t record = walking.back();
+   walking.pop_back();
+   if (tree == root) return;
+   if (tree->next_sibling != node_pool::NO_NODE) {
+      nodes[record].next_sibling = nodes.size();
+   }
+}
+
+bool ast_file::writer::write (FILE* astb_file) {
+   vector<uint32_t> files;
+   for (const string& name: filenames) {
+      files.push_back (strings.size());
+      strings.push_back (name);
+   }
+   vector<uint32_t> offsets;
+   string text;
+   for (string_view entry: strings) {
+      offsets.push_back (text.size());
+      text.append (entry);
+      text.push_back ('\0');
+   }
+   offsets.push_back (text.size());
+   header head {{}, VERSION, uint32_t (nodes.size()),
+                uint32_t (files.size()),
+                uint32_t (strings.size()),
+                uint32_t (text.size())};
+   memcpy (head.magic, MAGIC, sizeof MAGIC);
+   vector<char> image;
+   append (image, &head, 1);
+   append (image, nodes.data(), nodes.size());
+   append (image, files.data(), files.size());
+   append (image, offsets.data(), offsets.size());
+   append (image, text.data(), text.size());
+   return fwrite (image.data(), 1, image.size(), astb_file)
+          == image.size();
+}
+
+bool ast_file::write (FILE* astb_file, astree* root,
+                      const vector<string>& filenames) {
+   writer image (filenames);
+   visit (root, image);
+   return image.write (astb_file);
+}
+
+//The parts of a mapped .astb file, once their sizes are checked.
+struct astb_image {
+   const ast_file::header* head;
+   const ast_file::node* nodes;
+   const uint32_t* files;
+   const uint32_t* offsets;
+   const char* text;
+   bool parse (const char* base, size_t length);
+   bool check_nodes() const;
+   string_view string_at (uint32_t number) const {
+      return {text + offsets[number],
+              offsets[number + 1] - offsets[number] - 1};
+   }
+};
+
+bool astb_image::parse (const char* base, size_t length) {
+   if (length < sizeof *head) return false;
+   head = reinterpret_cast<const ast_file::header*> (base);
+   if (memcmp (head->magic, MAGIC, sizeof MAGIC) != 0
+    or head->version != ast_file::VERSION
+    or head->node_count == 0 or head->file_count == 0) return false;
+   size_t strings = size_t (head->string_count) + 1;
+   size_t expected = sizeof *head
+                   + head->node_count * sizeof *nodes
+                   + head->file_count * sizeof *files
+                   + strings * sizeof *offsets + head->text_size;
+   if (length != expected) return false;
+   nodes = reinterpret_cast<const ast_file::node*> (head + 1);
+   files = reinterpret_cast<const uint32_t*> (nodes
+                                              + head->node_count);
+   offsets = files + head->file_count;
+   text = reinterpret_cast<const char*> (offsets
+                                         + head->string_count + 1);
+   for (uint32_t number = 0; number < head->string_count;
+        ++number) {
+      uint32_t end = offsets[number + 1];
+      if (offsets[number] >= end or end > head->text_size
+       or text[end - 1] != '\0') return false;
+   }
+   for (uint32_t file = 0; file < head->file_count; ++file) {
+      if (files[file] >= head->string_count) return false;
+   }
+   return check_nodes();
+}
+
+//Links must point forward, as preorder numbers do, so a bad
+//file cannot make a cycle, and each node may have one parent.
+bool astb_image::check_nodes() const {
+   vector<bool> linked (head->node_count);
+   for (uint32_t record = 0; record < head->node_count; ++record) {
+      const ast_file::node& entry = nodes[record];
+      if (entry.lexinfo >= head->string_count
+       or entry.filenr >= head->file_count) return false;
+      uint32_t after = record;
+      for (uint32_t child = entry.first_child; child != 0;
+           child = nodes[child].next_sibling) {
+         if (child <= after or child >= head->node_count
+          or linked[child]) return false;
+         linked[child] = true;
+         after = child;
+      }
+   }
+   return true;
+}
+
+astree* ast_file::load (const string& filename,
+                        vector<string>& filenames) {
+   int fd = open (filename.c_str(), O_RDONLY);
+   if (fd < 0) {
+      syserrprintf (filename.c_str());
+      return nullptr;
+   }
+   struct stat status;
+   if (fstat (fd, &status) != 0 or status.st_size == 0) {
+      errprintf ("%:%s: not a .astb file\n", filename.c_str());
+      close (fd);
+      return nullptr;
+   }
+   size_t length = status.st_size;
+   void* mapping = mmap (nullptr, length, PROT_READ, MAP_PRIVATE,
+                         fd, 0);
+   close (fd);
+   if (mapping == MAP_FAILED) {
+      syserrprintf (filename.c_str());
+      return nullptr;
+   }
+   astb_image image;
+   const char* base = static_cast<const char*> (mapping);
+   if (not image.parse (base, length)) {
+      errprintf ("%:%s: not a version %u .astb file\n",
+                 filename.c_str(), VERSION);
+      munmap (mapping, length);
+      return nullptr;
+   }
+   for (uint32_t file = 0; file < image.head->file_count; ++file) {
+      filenames.emplace_back (image.string_at (image.files[file]));
+   }
+   // Each lexinfo is interned once, when a node first uses it.
+   vector<const interned*> strings (image.head->string_count);
+   vector<astree*> trees;
+   for (uint32_t record = 0; record < image.head->node_count;
+        ++record) {
+      const node& entry = image.nodes[record];
+      const interned*& lexinfo = strings[entry.lexinfo];
+      if (lexinfo == nullptr) {
+         string_view text = image.string_at (entry.lexinfo);
+         lexinfo = string_set::intern (text.data(), text.size());
+      }
+      trees.push_back (new astree (entry.symbol,
+                       {entry.filenr, entry.linenr, entry.offset},
+                       lexinfo));
+   }
+   for (uint32_t record = 0; record < image.head->node_count;
+        ++record) {
+      for (uint32_t child = image.nodes[record].first_child;
+           child != 0; child = image.nodes[child].next_sibling) {
+         trees[record]->adopt (trees[child]);
+      }
+   }
+   munmap (mapping, length);
+   return trees.front();
+}
+
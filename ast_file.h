@@ -0,0 +1,82 @@
+#ifndef __AST_FILE_H__
+#define __AST_FILE_H__
+
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "astree.h"
+#include "visitor.h"
+
+//
+// DESCRIPTION
+//    The .astb file: a syntax tree in a binary form that is read
+//    back by mapping it, with no text to parse.  After a header
+//    come the nodes in preorder as fixed-size records, then the
+//    string numbers of the included file names, then a string
+//    table of the lexinfo and file names, as offsets followed by
+//    the NUL-terminated text.  Child links are record numbers, and
+//    since the root is record 0, 0 also means no node.  The whole
+//    file is built in memory and written in one fwrite.
+//
+
+struct ast_file {
+   static constexpr uint32_t VERSION = 1;
+
+   struct header {
+      char magic[4];            // "OCAB"
+      uint32_t version;
+      uint32_t node_count;
+      uint32_t file_count;
+      uint32_t string_count;
+      uint32_t text_size;
+   };
+
+   struct node {
+      int32_t symbol;
+      uint32_t filenr;
+      uint32_t linenr;
+      uint32_t offset;
+      uint32_t lexinfo;         // string number
+      uint32_t first_child;
+      uint32_t next_sibling;
+   };
+
+   struct writer;
+
+   static bool write (FILE* astb_file, astree* root,
+                      const vector<string>& filenames);
+   // Writes root and the file names its locations refer to.
+
+   static astree* load (const string& filename,
+                        vector<string>& filenames);
+   // Rebuilds the tree in filename and appends its file names, or
+   // returns nullptr, having printed a message, if it is not a
+   // valid .astb file.
+};
+
+//Builds the image of a tree as it is visited, so that it may be
+//fused with other passes, then writes it.
+struct ast_file::writer: visitor<ast_file::writer> {
+   writer (const vector<string>& filenames);
+   bool pre_node (astree* tree, int depth);
+   void post_node (astree* tree);
+   bool write (FILE* astb_file);
+
+   private:
+   const vector<string>& filenames;
+   astree* root;
+   vector<node> nodes;
+   vector<uint32_t> walking;  // records of the nodes being walked
+   vector<uint32_t> numbers;  // by interned id, 1 + string number
+   vector<string_view> strings;
+   uint32_t number (const interned* text);
+   // Numbers each lexinfo the first time it is used.
+};
+
+#endif
+
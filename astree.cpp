@@ -10,25 +10,54 @@
 #include "astree.h"
 #include "string_set.h"
 #include "lyutils.h"
+#include "visitor.h"
 
-extern FILE* tok_file;
+thread_local node_pool* astree::pool = nullptr;
+static thread_local node_pool thread_nodes;
 
-astree::astree (int symbol_, const location& lloc_, const char* info) {
+static_assert (sizeof (astree) <= node_pool::SLOT_SIZE,
+               "astree must fit in a node_pool slot");
+
+astree::astree (int symbol_, const location& lloc_, const char* info):
+        astree (symbol_, lloc_, string_set::intern (info)) {
+}
+
+astree::astree (int symbol_, const location& lloc_,
+                const interned* info) {
    symbol = symbol_;
    lloc = lloc_;
-   lexinfo = string_set::intern (info);
-   // vector defaults to empty -- no children
+   lexinfo = info;
+   children = {node_pool::NO_NODE, node_pool::NO_NODE, 0};
+   next_sibling = node_pool::NO_NODE;
    block_nr = 0;
-   attributes = *(new attr_bitset());
    symbol_item = nullptr;
 }
 
+void* astree::operator new (size_t size) {
+   assert (size <= node_pool::SLOT_SIZE);
+   if (pool == nullptr) return thread_nodes.allocate();
+   return pool->allocate();
+}
+
+void astree::operator delete (void* tree) {
+   assert (pool == nullptr);
+   thread_nodes.release (tree);
+}
+
+vector<astree::walk_frame>& astree::walk_stack() {
+   static thread_local vector<walk_frame> stack;
+   return stack;
+}
+
+//Deletes the descendants bottom up, each after its children have
+//been unlinked from it, so no destructor recurses.
 astree::~astree() {
-   while (not children.empty()) {
-      astree* child = children.back();
-      children.pop_back();
-      delete child;
-   }
+   walk (this, [] (astree*, int) { return true; },
+         [this] (astree* tree) {
+      if (tree == this) return;
+      tree->children = {node_pool::NO_NODE, node_pool::NO_NODE, 0};
+      delete tree;
+   });
    if (yydebug) {
       fprintf (stderr, "Deleting astree (");
       astree::dump (stderr, this);
@@ -36,6 +65,25 @@ astree::~astree() {
    }
 }
 
+astree* astree::child_list::at (size_t child) const {
+   if (child >= count) {
+      throw out_of_range ("astree::child_list::at: "
+                          + to_string (child));
+   }
+   uint32_t index = first;
+   for (; child > 0; --child) index = node (index)->next_sibling;
+   return node (index);
+}
+
+void astree::child_list::push_back (astree* child) {
+   uint32_t index = child->index();
+   child->next_sibling = node_pool::NO_NODE;
+   if (count == 0) first = index;
+              else node (last)->next_sibling = index;
+   last = index;
+   ++count;
+}
+
 astree* astree::adopt (astree* child1, astree* child2) {
    if (child1 != nullptr) children.push_back (child1);
    if (child2 != nullptr) children.push_back (child2);
@@ -52,22 +100,23 @@ void astree::zap_sym (int symbol_) {
 }
 
 void astree::dump_node (FILE* outfile) {
-   fprintf (outfile, "%p->{%s %zd.%zd.%zd \"%s\":",
+   fprintf (outfile, "%p->{%s %u.%u.%u \"%s\":",
             static_cast<const void*> (this),
             parser::get_tname (symbol),
             lloc.filenr, lloc.linenr, lloc.offset,
             lexinfo->c_str());
-   for (size_t child = 0; child < children.size(); ++child) {
-      fprintf (outfile, " %p",
-               static_cast<const void*> (children.at(child)));
+   for (astree* child: children) {
+      fprintf (outfile, " %p", static_cast<const void*> (child));
    }
 }
 
 void astree::dump_tree (FILE* outfile, int depth) {
-   fprintf (outfile, "%*s", depth * 3, "");
-   dump_node (outfile);
-   fprintf (outfile, "\n");
-   for (astree* child: children) child->dump_tree (outfile, depth + 1);
+   walk (this, [outfile, depth] (astree* tree, int level) {
+      fprintf (outfile, "%*s", (depth + level) * 3, "");
+      tree->dump_node (outfile);
+      fprintf (outfile, "\n");
+      return true;
+   }, [] (astree*) {});
    fflush (nullptr);
 }
 
@@ -76,36 +125,7 @@ void astree::dump (FILE* outfile, astree* tree) {
                    else tree->dump_node (outfile);
 }
 
-const string attr_to_string (size_t attri) {
-    attr attribute = static_cast<attr> (attri);
-    static const unordered_map<attr, string> hash {
-            {attr::VOID       , "void"       },
-            {attr::INT        , "int"        },
-            {attr::NULLPTR_T  , "null"       },
-            {attr::STRING     , "string"     },
-            {attr::STRUCT     , "struct"     },
-            {attr::ARRAY      , "array"      },
-            {attr::FUNCTION   , "function"   },
-            {attr::VARIABLE   , "variable"   },
-            {attr::FIELD      , "field"      },
-            {attr::TYPEID     , "typeid"     },
-            {attr::PARAM      , "param"      },
-            {attr::LOCAL      , "local"      },
-            {attr::LVAL       , "lval"       },
-            {attr::CONST      , "const"      },
-            {attr::VREG       , "vreg"       },
-            {attr::VADDR      , "vaddr"      },
-            {attr::BITSET_SIZE, "bitset_size"},
-    };
-    auto str = hash.find (attribute);
-    if (str == hash.end()) {
-        throw invalid_argument (string (__PRETTY_FUNCTION__) + ": "
-                + to_string (unsigned (attribute)));
-    }
-    return str->second;
-}
-
-void astree::print (FILE* outfile, astree* tree, int depth) {
+static void print_node (FILE* outfile, astree* tree, int depth) {
    for(int i = 0; i < depth; ++i) {
       fprintf (outfile, "|  ");
    }
@@ -113,58 +133,59 @@ void astree::print (FILE* outfile, astree* tree, int depth) {
    const char *tname = parser::get_tname(tree->symbol);
    if(strstr (tname, "TOK_") == tname) tname += 4;
 
-    if(strcmp("ROOT", tname) != 0){
-       fprintf(tok_file, " %4ld   %-6.3f  %-3d  %-10s  %-s\n",
-           tree->lloc.filenr, tree->lloc.linenr + 
-           tree->lloc.offset/1.0000, tree->symbol, 
-           tname, tree->lexinfo->c_str());
-   }
-
-
-   fprintf (outfile, "%s \"%s\" (%zd.%zd.%zd)\n",
+   fprintf (outfile, "%s \"%s\" (%u.%u.%u)\n",
             tname, tree->lexinfo->c_str(),
             tree->lloc.filenr, tree->lloc.linenr, tree->lloc.offset);
 
 
    for(size_t i = 0; i < static_cast<size_t>(attr::BITSET_SIZE); ++i) {
        if(tree->attributes.test(i)){
-           const char* s = attr_to_string(i).c_str();
-           if(!strcmp(s, "typeid"))
+           if(i == static_cast<size_t>(attr::TYPEID))
                continue;
 
-           fprintf(outfile, " %s", attr_to_string(i).c_str());
+           fprintf(outfile, " %s", attr_names[i]);
            
-           if(!strcmp(s, "struct")) {
+           if(i == static_cast<size_t>(attr::STRUCT)) {
                if(tree->symbol_item != nullptr)
-               fprintf(outfile, " \"%s\"", 
-                       tree->symbol_item->type_name.c_str());
+               fprintf(outfile, " \"%.*s\"", 
+                       int(tree->symbol_item->type_name.size()),
+                       tree->symbol_item->type_name.data());
            }
        }
    }
 
    if(tree->symbol_item != nullptr) {
-       fprintf(outfile, " (%zd.%zd.%zd)", 
+       fprintf(outfile, " (%u.%u.%u)", 
                tree->symbol_item->lloc.filenr,
                tree->symbol_item->lloc.linenr,
                tree->symbol_item->lloc.offset);
    }
+}
 
-   for (astree* child: tree->children) {
-      astree::print (outfile, child, depth + 1);
-   }
+bool ast_printer::pre_node (astree* node, int level) {
+   print_node (outfile, node, depth + level);
+   return true;
+}
+
+void astree::print (FILE* outfile, astree* tree, int depth) {
+   ast_printer printer (outfile, depth);
+   visit (tree, printer);
 }
   
 void destroy (astree* tree1, astree* tree2) {
+   if (astree::pool != nullptr) return;
    if (tree1 != nullptr) delete tree1;
    if (tree2 != nullptr) delete tree2;
 }
 
 void errllocprintf (const location& lloc, const char* format,
                     const char* arg) {
-   static char buffer[0x1000];
+   static thread_local char buffer[0x1000];
    assert (sizeof buffer > strlen (format) + strlen (arg));
    snprintf (buffer, sizeof buffer, format, arg);
-   const string* filename = lexer::filename (lloc.filenr);
-   errprintf ("%s:%zd.%zd: %s", (*filename).c_str(), lloc.linenr, 
+   const lexer* lex = lexer::current;
+   const char* filename = lex == nullptr ? "-"
+                        : lex->filename (lloc.filenr)->c_str();
+   errprintf ("%s:%u.%u: %s", filename, lloc.linenr, 
            lloc.offset, buffer);
 }
@@ -7,40 +7,138 @@
 #include <vector>
 using namespace std;
 
+#include <stdint.h>
+
 #include "auxlib.h"
+#include "node_pool.h"
+#include "string_set.h"
 
 struct location {
-   size_t filenr;
-   size_t linenr;
-   size_t offset;
+   uint32_t filenr;
+   uint32_t linenr;
+   uint32_t offset;
 };
 
 #include "symbol_table.h"
 
+//
+// DESCRIPTION
+//    A node is one 64-byte slot of a node_pool, and nodes refer to
+//    each other by pool index rather than by pointer.  Children
+//    are linked through next_sibling, and children is a view of
+//    that list with the parts of vector the passes use: size, at,
+//    front, back and iteration.  at walks the list, so loops over
+//    all children should use iteration instead.
+//
+
 struct astree {
+   struct child_list {
+      struct iterator {
+         uint32_t index;
+         astree* operator*() const { return node (index); }
+         iterator& operator++() {
+            index = node (index)->next_sibling;
+            return *this;
+         }
+         bool operator== (iterator that) const {
+            return index == that.index;
+         }
+         bool operator!= (iterator that) const {
+            return index != that.index;
+         }
+      };
+      uint32_t first;
+      uint32_t last;
+      uint32_t count;
+      iterator begin() const { return {first}; }
+      iterator end() const { return {node_pool::NO_NODE}; }
+      size_t size() const { return count; }
+      bool empty() const { return count == 0; }
+      astree* front() const { return node (first); }
+      astree* back() const { return node (last); }
+      astree* at (size_t child) const;
+      astree* operator[] (size_t child) const { return at (child); }
+      void push_back (astree* child);
+   };
 
    // Fields.
    int symbol;               // token code
    location lloc;            // source location
-   const string* lexinfo;    // pointer to lexical information
-   vector<astree*> children; // children of this n-way node
-   size_t block_nr;
+   const interned* lexinfo;  // lexical information
+   child_list children;      // children of this n-way node
+   uint32_t next_sibling;    // index of the next child of the parent
+   uint32_t block_nr;
    attr_bitset attributes;
    symbol_node* symbol_item;
 
+   static thread_local node_pool* pool;
+   // While set, nodes are allocated here and are freed only by
+   // resetting it: destroy does nothing, and the nodes must not
+   // be deleted.  Otherwise they come from a pool belonging to
+   // the thread, and must be deleted by that thread.
+
    // Functions.
    astree (int symbol, const location&, const char* lexinfo);
+   astree (int symbol, const location&, const interned* lexinfo);
+   // lexinfo must come from string_set::intern.
    ~astree();
+   static void* operator new (size_t size);
+   static void operator delete (void* tree);
    astree* adopt (astree* child1, astree* child2 = nullptr);
    astree* adopt_sym (astree* child, int symbol);
    void zap_sym (int symbol);
+   uint32_t index() const { return node_pool::index (this); }
+   static astree* node (uint32_t index) {
+      return static_cast<astree*> (node_pool::slot (index));
+   }
    void dump_node (FILE*);
    void dump_tree (FILE*, int depth = 0);
    static void dump (FILE* outfile, astree* tree);
    static void print (FILE* outfile, astree* tree, int depth = 0);
    static astree* function_(astree* a, astree* b, astree* c = nullptr);
+
+   template <typename enter_t, typename leave_t>
+   static void walk (astree* tree, enter_t enter, leave_t leave);
+   // Visits tree and its descendants with an explicit stack, so
+   // any depth of tree can be walked.  enter (node, depth) is
+   // called first and returns false to skip the node's children;
+   // leave (node) is called after them.  Either may walk again.
+
+   private:
+   struct walk_frame {
+      astree* node;
+      uint32_t child;        // index of the next child to enter
+      int depth;
+   };
+   static vector<walk_frame>& walk_stack();
+   // Shared by the walks on a thread; each uses the frames above
+   // those it found, so it grows only once.
 };
 
+template <typename enter_t, typename leave_t>
+void astree::walk (astree* tree, enter_t enter, leave_t leave) {
+   vector<walk_frame>& stack = walk_stack();
+   size_t base = stack.size();
+   auto push = [&stack, &enter] (astree* node, int depth) {
+      bool descend = enter (node, depth);
+      stack.push_back ({node, descend ? node->children.first
+                                      : node_pool::NO_NODE, depth});
+   };
+   push (tree, 0);
+   while (stack.size() > base) {
+      walk_frame& top = stack.back();
+      if (top.child == node_pool::NO_NODE) {
+         astree* done = top.node;
+         stack.pop_back();
+         leave (done);
+         continue;
+      }
+      astree* child = node (top.child);
+      top.child = child->next_sibling;
+      push (child, top.depth + 1);
+   }
+}
+
 void destroy (astree* tree1, astree* tree2 = nullptr);
 
 void errllocprintf (const location&, const char* format, const char*);
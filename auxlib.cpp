@@ -13,7 +13,9 @@
 #include "auxlib.h"
 
 string exec::execname;
-int exec::exit_status = EXIT_SUCCESS;
+thread_local int exec::exit_status = EXIT_SUCCESS;
+thread_local string* exec::captured_out = nullptr;
+thread_local string* exec::captured_err = nullptr;
 
 const char* debugflags = "";
 bool alldebugflags = false;
@@ -46,18 +48,55 @@ void eprint_status (const char* command, int status) {
 }
 
 
+static void capture (string* captured, const char* format,
+                     va_list args) {
+   if (captured == nullptr) return;
+   char buffer[0x1000];
+   va_list again;
+   va_copy (again, args);
+   int size = vsnprintf (buffer, sizeof buffer, format, args);
+   if (size >= 0 and static_cast<size_t> (size) < sizeof buffer) {
+      captured->append (buffer, size);
+   }else if (size >= 0) {
+      string text (size, '\0');
+      vsnprintf (&text[0], size + 1, format, again);
+      captured->append (text);
+   }
+   va_end (again);
+}
+
 void veprintf (const char* format, va_list args) {
    assert (exec::execname.size() != 0);
    assert (format != nullptr);
    fflush (nullptr);
    if (strstr (format, "%:") == format) {
       fprintf (stderr, "%s: ", exec::execname.c_str());
+      if (exec::captured_err != nullptr) {
+         *exec::captured_err += exec::execname + ": ";
+      }
       format += 2;
    }
+   va_list copy;
+   va_copy (copy, args);
+   capture (exec::captured_err, format, copy);
+   va_end (copy);
    vfprintf (stderr, format, args);
    fflush (nullptr);
 }
 
+void outprintf (const char* format, ...) {
+   va_list args;
+   va_start (args, format);
+   if (exec::captured_out != nullptr) {
+      va_list copy;
+      va_copy (copy, args);
+      capture (exec::captured_out, format, copy);
+      va_end (copy);
+   }
+   vprintf (format, args);
+   va_end (args);
+}
+
 void eprintf (const char* format, ...) {
    va_list args;
    va_start (args, format);
@@ -92,7 +131,7 @@ void __stubprintf (const char* file, int line, const char* func,
 void set_debugflags (const char* flags) {
    debugflags = flags;
    assert (debugflags != nullptr);
-   if (strchr (debugflags, '@') != nullptr) alldebugflags = true;
+   alldebugflags = strchr (debugflags, '@') != nullptr;
    DEBUGF ('x', "Debugflags = \"%s\", all = %d\n",
            debugflags, alldebugflags);
 }
@@ -19,13 +19,23 @@ using namespace std;
 
 struct exec {
    static string execname;
-   static int exit_status;
+   static thread_local int exit_status;
+   static thread_local string* captured_out;
+   static thread_local string* captured_err;
 };
+// The exit status is per thread so that each compilation in a
+// batch run accumulates its own errors; see compile_unit.
+// When captured_out or captured_err is set, everything this thread
+// prints to stdout with outprintf or to stderr with eprintf is also
+// appended to it, so that the compile cache can replay it.
 
 void veprintf (const char* format, va_list args);
 // Prints a message to stderr using the vector form of 
 // argument list.
 
+void outprintf (const char* format, ...);
+// Print a message to stdout according to the printf format.
+
 void eprintf (const char* format, ...);
 // Print a message to stderr according to the printf format
 // specified.  Usually called for debug output.
@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+namespace fs = std::filesystem;
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "auxlib.h"
+#include "compile_cache.h"
+#include "compile_unit.h"
+#include "lyutils.h"
+#include "preprocessor.h"
+
+string compile_cache::directory;
+size_t compile_cache::max_size = size_t (256) << 20;
+
+// Eviction stops once the cache is this fraction of max_size.
+static const double evict_to = 0.9;
+
+//Two independent 64-bit FNV-style hashes, giving a 128-bit key.
+struct source_hash {
+   uint64_t high = 0xcbf29ce484222325;
+   uint64_t low = 0x84222325cbf29ce4;
+
+   void update (const char* data, size_t size) {
+      for (size_t i = 0; i < size; ++i) {
+         uint8_t byte = data[i];
+         high = (high ^ byte) * 0x100000001b3;
+         low = (low + byte) * 0xff51afd7ed558ccd;
+         low ^= low >> 31;
+      }
+   }
+   void update (const string& text) {
+      uint64_t size = text.size();
+      update (reinterpret_cast<const char*> (&size), sizeof size);
+      update (text.data(), text.size());
+   }
+   string hex() const {
+      char buffer[33];
+      snprintf (buffer, sizeof buffer, "%016llx%016llx",
+                static_cast<unsigned long long> (high),
+                static_cast<unsigned long long> (low));
+      return buffer;
+   }
+};
+
+//Identifies this build of the compiler by its size and mtime.
+static const string& executable_id() {
+   static const string id = [] {
+      struct stat info;
+      if (stat ("/proc/self/exe", &info) != 0) return string ("?");
+      return to_string (info.st_size) + "."
+           + to_string (info.st_mtime);
+   }();
+   return id;
+}
+
+static fs::path entry_path (const string& key) {
+   return fs::path (compile_cache::directory)
+        / key.substr (0, 2) / key.substr (2);
+}
+
+static bool read_file (const fs::path& path, string& text) {
+   ifstream file (path, ios::binary);
+   if (not file) return false;
+   ostringstream buffer;
+   buffer << file.rdbuf();
+   text = buffer.str();
+   return true;
+}
+
+static bool write_file (const fs::path& path, const string& text) {
+   ofstream file (path, ios::binary);
+   file << text;
+   return bool (file);
+}
+
+//Applies update to the counters in the stats file, which is locked
+//against other oc processes for the duration.
+using counters = map<string, uint64_t>;
+template <typename function>
+static counters update_stats (function update) {
+   counters stats;
+   error_code error;
+   fs::create_directories (compile_cache::directory, error);
+   string path = compile_cache::directory + "/stats";
+   int fd = open (path.c_str(), O_RDWR | O_CREAT, 0644);
+   if (fd < 0) return stats;
+   flock (fd, LOCK_EX);
+   string text;
+   char buffer[0x400];
+   for(;;) {
+      ssize_t count = read (fd, buffer, sizeof buffer);
+      if (count <= 0) break;
+      text.append (buffer, count);
+   }
+   istringstream input (text);
+   string name;
+   uint64_t value;
+   while (input >> name >> value) stats[name] = value;
+   update (stats);
+   ostringstream output;
+   for (const auto& stat: stats) {
+      output << stat.first << " " << stat.second << "\n";
+   }
+   text = output.str();
+   if (ftruncate (fd, 0) == 0 and lseek (fd, 0, SEEK_SET) == 0) {
+      ssize_t written = write (fd, text.data(), text.size());
+      (void) written;
+   }
+   flock (fd, LOCK_UN);
+   close (fd);
+   return stats;
+}
+
+//Removes least recently used entries until the cache fits.
+//Returns the size of what remains.
+static uint64_t evict() {
+   struct cached {
+      fs::file_time_type used;
+      fs::path path;
+      uint64_t size;
+   };
+   vector<cached> entries;
+   uint64_t total = 0;
+   error_code error;
+   for (const auto& prefix: fs::directory_iterator (
+        compile_cache::directory, error)) {
+      if (not prefix.is_directory() or prefix.path().filename()
+          .string().size() != 2) continue;
+      for (const auto& dir: fs::directory_iterator (prefix, error)) {
+         uint64_t size = 0;
+         for (const auto& file: fs::directory_iterator (dir, error)) {
+            size += file.file_size (error);
+         }
+         entries.push_back ({fs::last_write_time (dir, error),
+                             dir.path(), size});
+         total += size;
+      }
+   }
+   sort (entries.begin(), entries.end(),
+         [] (const cached& a, const cached& b) {
+            return a.used < b.used;
+         });
+   uint64_t target = compile_cache::max_size * evict_to;
+   for (const cached& entry: entries) {
+      if (total <= target) break;
+      fs::remove_all (entry.path, error);
+      total -= entry.size;
+   }
+   return total;
+}
+
+string compile_cache::key (const string& filename,
+                           const string& source) {
+   source_hash hash;
+   hash.update (executable_id());
+   hash.update (filename);
+   string options;
+   if (preprocessor::builtin) options += 'p';
+   if (lexer::mapped) options += 'm';
+   if (lexer::interactive) options += 'i';
+   options += to_string (compile_unit::emit);
+   hash.update (options);
+   hash.update (source);
+   return hash.hex();
+}
+
+bool compile_cache::fetch (const string& key, const string& stem,
+                           vector<string>& files, entry& result) {
+   fs::path path = entry_path (key);
+   string status;
+   if (not read_file (path / "status", status)
+    or not read_file (path / "stdout", result.out)
+    or not read_file (path / "stderr", result.err)) {
+      update_stats ([] (counters& stats) { ++stats["misses"]; });
+      return false;
+   }
+   result.exit_status = atoi (status.c_str());
+   error_code error;
+   for (const auto& file: fs::directory_iterator (path, error)) {
+      string suffix = file.path().filename().string();
+      if (suffix == "status" or suffix == "stdout"
+          or suffix == "stderr") continue;
+      string name = stem + "." + suffix;
+      fs::copy_file (file.path(), name,
+                     fs::copy_options::overwrite_existing, error);
+      if (error) {
+         errprintf ("%:%s: %s\n", name.c_str(),
+                    error.message().c_str());
+         return false;
+      }
+      files.push_back (name);
+   }
+   fs::last_write_time (path, fs::file_time_type::clock::now(), error);
+   update_stats ([] (counters& stats) { ++stats["hits"]; });
+   return true;
+}
+
+//Builds the entry in a private directory, then renames it into
+//place, so that readers never see a partial entry.
+void compile_cache::store (const string& key,
+                           const vector<string>& files,
+                           const entry& result) {
+   fs::path path = entry_path (key);
+   error_code error;
+   fs::create_directories (path.parent_path(), error);
+   ostringstream tmpname;
+   tmpname << "tmp." << getpid() << "." << this_thread::get_id();
+   fs::path tmp = fs::path (directory) / tmpname.str();
+   fs::remove_all (tmp, error);
+   fs::create_directory (tmp, error);
+   bool written = not error
+              and write_file (tmp / "status",
+                              to_string (result.exit_status))
+              and write_file (tmp / "stdout", result.out)
+              and write_file (tmp / "stderr", result.err);
+   for (const string& file: files) {
+      if (not written) break;
+      string suffix = fs::path (file).extension().string();
+      if (suffix.empty()) continue;
+      fs::copy_file (file, tmp / suffix.substr (1), error);
+      written = not error;
+   }
+   uint64_t size = 0;
+   for (const auto& file: fs::directory_iterator (tmp, error)) {
+      size += file.file_size (error);
+   }
+   if (not written) {
+      fs::remove_all (tmp, error);
+      return;
+   }
+   fs::rename (tmp, path, error);
+   if (error) {
+      // Another process stored the same entry first.
+      fs::remove_all (tmp, error);
+      return;
+   }
+   update_stats ([size] (counters& stats) {
+      stats["size"] += size;
+      if (stats["size"] > compile_cache::max_size) {
+         stats["size"] = evict();
+      }
+   });
+}
+
+void compile_cache::print_stats (FILE* outfile) {
+   counters stats = update_stats ([] (counters&) {});
+   uint64_t lookups = stats["hits"] + stats["misses"];
+   fprintf (outfile, "cache directory  %s\n", directory.c_str());
+   fprintf (outfile, "cache hits       %llu\n",
+            static_cast<unsigned long long> (stats["hits"]));
+   fprintf (outfile, "cache misses     %llu\n",
+            static_cast<unsigned long long> (stats["misses"]));
+   fprintf (outfile, "hit rate         %.1f%%\n",
+            lookups == 0 ? 0.0 : 100.0 * stats["hits"] / lookups);
+   fprintf (outfile, "cache size       %.1f of %.1f MiB\n",
+            stats["size"] / 1048576.0, max_size / 1048576.0);
+}
+
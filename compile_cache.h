@@ -0,0 +1,45 @@
+#ifndef __COMPILE_CACHE_H__
+#define __COMPILE_CACHE_H__
+
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <stdio.h>
+
+//
+// DESCRIPTION
+//    On-disk cache of whole compilations.  An entry is keyed by a
+//    hash of the preprocessed source, the compiler executable, the
+//    file name and the options that change the output.  It holds
+//    the output files, the text written to stdout and stderr, and
+//    the exit status.  Every output, the .str file included, must
+//    follow from what the key hashes and nothing else, such as the
+//    other files of a batch.  Least recently used entries are
+//    evicted when the cache grows past its size limit.
+//
+
+struct compile_cache {
+   static string directory;  // where entries live; empty disables
+   static size_t max_size;   // bytes, before eviction starts
+
+   struct entry {
+      int exit_status;
+      string out;            // text written to stdout
+      string err;            // text written to stderr
+   };
+
+   static bool enabled() { return not directory.empty(); }
+   static string key (const string& filename, const string& source);
+   static bool fetch (const string& key, const string& stem,
+                      vector<string>& files, entry& result);
+   // On a hit, copies the output files to stem.suffix and
+   // appends their names to files.
+
+   static void store (const string& key, const vector<string>& files,
+                      const entry& result);
+   static void print_stats (FILE* outfile);
+};
+
+#endif
+
@@ -0,0 +1,418 @@
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+using namespace std;
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ast_file.h"
+#include "astree.h"
+#include "auxlib.h"
+#include "compile_unit.h"
+#include "emitter.h"
+#include "lyutils.h"
+#include "phase_timer.h"
+#include "preprocessor.h"
+#include "string_set.h"
+
+const string cpp_name = "/usr/bin/cpp";
+
+unsigned compile_unit::emit = compile_unit::ALL;
+bool compile_unit::streaming = false;
+bool compile_unit::token_thread = false;
+
+bool compile_unit::parse_emit (const string& list) {
+   static const struct {
+      const char* name;
+      artifact bit;
+   } names[] {
+      {"str", STR}, {"tok", TOK}, {"ast", AST}, {"sym", SYM},
+      {"oil", OIL}, {"astb", ASTB},
+   };
+   emit = 0;
+   size_t begin = 0;
+   while (begin <= list.size()) {
+      size_t end = list.find (',', begin);
+      if (end == string::npos) end = list.size();
+      string name = list.substr (begin, end - begin);
+      bool found = false;
+      for (const auto& entry: names) {
+         if (name != entry.name) continue;
+         emit |= entry.bit;
+         found = true;
+      }
+      if (not found) return false;
+      begin = end + 1;
+   }
+   return true;
+}
+
+compile_unit::compile_unit (const string& filename_, bool loaded_):
+             filename (filename_), loaded (loaded_),
+             root (nullptr), parse_rc (0),
+             exit_status (EXIT_SUCCESS), cached (false),
+             tok_stream (nullptr), ast_stream (nullptr),
+             sym_stream (nullptr), oil_stream (nullptr) {
+   size_t length = loaded ? 5 : 3;
+   size_t suffix = filename.size() < length ? filename.size()
+                                            : filename.size() - length;
+   stem = filename.substr (0, suffix);
+}
+
+compile_unit::~compile_unit() {
+   delete root;
+}
+
+// Open a pipe from the C preprocessor.
+// Returns nullptr, having printed a message, if it can't.
+FILE* compile_unit::cpp_popen() {
+   cpp_command = cpp_name + " " + filename;
+   FILE* pipe = popen (cpp_command.c_str(), "r");
+   if (pipe == nullptr) {
+      syserrprintf (cpp_command.c_str());
+      return nullptr;
+   }
+   if (lexer::debug) {
+      fprintf (stderr, "-- popen (%s), fileno(yyin) = %d\n",
+               cpp_command.c_str(), fileno (pipe));
+   }
+   lex.newfilename (cpp_command);
+   return pipe;
+}
+
+void compile_unit::cpp_pclose (FILE* pipe) {
+   int pclose_rc = pclose (pipe);
+   eprint_status (cpp_command.c_str(), pclose_rc);
+   if (pclose_rc != 0) exec::exit_status = EXIT_FAILURE;
+}
+
+//Reads the whole preprocessed source into text.  Returns false,
+//having printed a message, if it can't.
+bool compile_unit::read_source (string& text) {
+   phase_timer timer ("cpp", filename);
+   if (preprocessor::builtin) {
+      preprocessor cpp;
+      lex.newfilename (filename);
+      return cpp.run (filename, text);
+   }
+   if (lexer::mapped) {
+      ifstream file (filename, ios::binary);
+      if (not file) {
+         syserrprintf (filename.c_str());
+         return false;
+      }
+      ostringstream buffer;
+      buffer << file.rdbuf();
+      text = buffer.str();
+      lex.newfilename (filename);
+      return true;
+   }
+   FILE* pipe = cpp_popen();
+   if (pipe == nullptr) return false;
+   char buffer[0x10000];
+   for(;;) {
+      size_t count = fread (buffer, 1, sizeof buffer, pipe);
+      if (count == 0) break;
+      text.append (buffer, count);
+   }
+   cpp_pclose (pipe);
+   return true;
+}
+
+//In streaming mode the output files are opened first and each
+//top-level item is written out and freed as soon as it is parsed.
+//Should the parse fail, the partial files are removed, as if they
+//had never been opened.
+int compile_unit::run_parser (parser& state) {
+   if (not streaming) return state.parse();
+   open_streams();
+   state.consume = [this] (astree* item) { stream_item (item); };
+   int rc = state.parse();
+   close_streams (rc == 0);
+   return rc;
+}
+
+void compile_unit::open_streams() {
+   if (emit & TOK) {
+      tok_stream = open_output (".tok");
+      if (tok_stream != nullptr) {
+         fprintf (tok_stream, "# \"%s\"\n", filename.c_str());
+      }
+   }
+   if (emit & AST) {
+      ast_stream = open_output (".ast");
+      if (ast_stream != nullptr) {
+         astree root_line (TOK_ROOT, {0, 0, 0}, "");
+         astree::print (ast_stream, &root_line);
+      }
+   }
+   if (emit & SYM) sym_stream = open_output (".sym");
+   if (emit & OIL) {
+      oil_stream = open_output (".oil");
+      if (oil_stream != nullptr) {
+         oil_code = make_unique<emitter> (oil_stream);
+      }
+   }
+}
+
+//The tokens scanned so far are written out with each item, so
+//the token log stays short.
+void compile_unit::stream_item (astree* item) {
+   if (tok_stream != nullptr) {
+      lex.tokens.print (tok_stream);
+      lex.tokens.records.clear();
+   }
+   if (ast_stream != nullptr) astree::print (ast_stream, item, 1);
+   if (oil_code != nullptr) oil_code->emit_item (item);
+}
+
+void compile_unit::close_streams (bool keep) {
+   if (tok_stream != nullptr and keep) lex.tokens.print (tok_stream);
+   lex.tokens.clear();
+   if (oil_code != nullptr) {
+      oil_code.reset();
+      if (keep) outprintf ("\n");
+   }
+   for (FILE* file: {tok_stream, ast_stream, sym_stream, oil_stream}) {
+      if (file != nullptr) fclose (file);
+   }
+   tok_stream = ast_stream = sym_stream = oil_stream = nullptr;
+   if (keep) return;
+   for (const string& name: artifacts) unlink (name.c_str());
+   artifacts.clear();
+}
+
+//Runs yylex and yyparse over text, which is scanned in place.
+void compile_unit::parse_text (string& text) {
+   phase_timer timer ("parse", filename);
+   parser state (lex);
+   lex.open (text);
+   parse_rc = run_parser (state);
+   lex.close();
+   root = state.root;
+}
+
+//Runs cpp, yylex and yyparse on this unit's own scanner and parser.
+void compile_unit::parse() {
+   if (lexer::mapped and not preprocessor::builtin) {
+      phase_timer timer ("parse", filename);
+      parser state (lex);
+      lex.newfilename (filename);
+      if (not lex.open_mapped (filename)) {
+         syserrprintf (filename.c_str());
+         parse_rc = 1;
+         return;
+      }
+      parse_rc = run_parser (state);
+      lex.close();
+      root = state.root;
+   }else if (preprocessor::builtin) {
+      string text;
+      if (not read_source (text)) {
+         parse_rc = 1;
+         return;
+      }
+      parse_text (text);
+   }else {
+      // cpp runs alongside the parser, so the two are timed as one.
+      phase_timer timer ("cpp+parse", filename);
+      parser state (lex);
+      FILE* pipe = cpp_popen();
+      if (pipe == nullptr) {
+         parse_rc = 1;
+         return;
+      }
+      lex.open (pipe);
+      parse_rc = run_parser (state);
+      lex.close();
+      cpp_pclose (pipe);
+      root = state.root;
+   }
+}
+
+//Reads the tree from a .astb file written by an earlier run, in
+//place of cpp, the scanner and the parser.
+void compile_unit::load() {
+   phase_timer timer ("load", filename);
+   root = ast_file::load (filename, lex.filenames);
+   if (root == nullptr) parse_rc = 1;
+}
+
+//Preprocesses, then either replays a cached compilation and
+//returns true, or parses the source and starts capturing output.
+bool compile_unit::fetch_cached() {
+   string text;
+   if (not read_source (text)) {
+      parse_rc = 1;
+      return false;
+   }
+   compile_cache::entry hit;
+   bool found;
+   {
+      phase_timer timer ("cache", filename);
+      cache_key = compile_cache::key (filename, text);
+      found = compile_cache::fetch (cache_key, stem, artifacts,
+                                    hit);
+   }
+   if (found) {
+      cached = true;
+      fwrite (hit.out.data(), 1, hit.out.size(), stdout);
+      fwrite (hit.err.data(), 1, hit.err.size(), stderr);
+      fflush (nullptr);
+      exec::exit_status = hit.exit_status;
+      return true;
+   }
+   exec::captured_out = &captured.out;
+   exec::captured_err = &captured.err;
+   parse_text (text);
+   return false;
+}
+
+FILE* compile_unit::open_output (const char* suffix) {
+   string name = stem + suffix;
+   FILE* file = fopen (name.c_str(), "w");
+   if (file == nullptr) syserrprintf (name.c_str());
+                   else artifacts.push_back (name);
+   return file;
+}
+
+//Only the requested files are opened, and only the passes that
+//produce them are run.  The .ast and .astb files are written from
+//one walk of the tree.  The .tok file is formatted from the token
+//log, on a thread of its own if token_thread is set.
+void compile_unit::write_outputs() {
+   thread tokens;
+   if (emit & TOK and not loaded) {
+      FILE* tok_file = open_output (".tok");
+      if (tok_file != nullptr) {
+         auto write_tokens = [this, tok_file] {
+            phase_timer timer ("tokens", filename);
+            fprintf (tok_file, "# \"%s\"\n", filename.c_str());
+            lex.tokens.print (tok_file);
+            fclose (tok_file);
+         };
+         if (token_thread) tokens = thread (write_tokens);
+                      else write_tokens();
+      }
+   }
+   if (emit & (AST | ASTB)) {
+      phase_timer timer ("ast", filename);
+      FILE* ast_out = emit & AST ? open_output (".ast") : nullptr;
+      FILE* astb_out = emit & ASTB ? open_output (".astb") : nullptr;
+      ast_printer printer (ast_out);
+      ast_file::writer image (lex.filenames);
+      if (ast_out != nullptr and astb_out != nullptr) {
+         visit (root, printer, image);
+      }else if (ast_out != nullptr) {
+         visit (root, printer);
+      }else if (astb_out != nullptr) {
+         visit (root, image);
+      }
+      if (ast_out != nullptr) fclose (ast_out);
+      if (astb_out != nullptr) {
+         if (not image.write (astb_out)) {
+            syserrprintf ((stem + ".astb").c_str());
+         }
+         fclose (astb_out);
+      }
+   }
+   // The symbol pass is not run yet, so the .sym file is left
+   // empty and there is no phase to time.
+   if (emit & SYM) {
+      FILE* sym_file = open_output (".sym");
+      if (sym_file != nullptr) {
+        /* symbol_generator* generator = new symbol_generator(sym_file);
+         generator->traverse(root);*/
+         fclose (sym_file);
+      }
+   }
+   if (emit & OIL) {
+      phase_timer timer ("emit", filename);
+      FILE* oil_file = open_output (".oil");
+      if (oil_file != nullptr) {
+         emit_sm_code (root, oil_file);
+         fclose (oil_file);
+      }
+   }
+   if (tokens.joinable()) tokens.join();
+}
+
+//The unit's errors are counted in exec::exit_status while it runs,
+//and the thread's own status, which may hold errors from option
+//parsing, is put back when it is done.
+void compile_unit::compile() {
+   int outer_status = exec::exit_status;
+   exec::exit_status = EXIT_SUCCESS;
+   lexer::current = &lex;
+   string_set::used = &strings;
+   lex.log_tokens = emit & TOK;
+   // A whole tree is built in the pool and freed in one reset.
+   // A streamed one is freed item by item, from the thread's pool.
+   // A loaded tree is never streamed.
+   bool whole = loaded or not streaming;
+   if (whole) astree::pool = &nodes;
+   // Traces from -l and -y are not worth caching.
+   if (loaded) {
+      load();
+   }else if (compile_cache::enabled() and not yydebug
+             and not lexer::debug) {
+      if (fetch_cached()) {
+         astree::pool = nullptr;
+         string_set::used = nullptr;
+         exit_status = exec::exit_status;
+         exec::exit_status = outer_status;
+         return;
+      }
+   }else {
+      parse();
+   }
+   if (yydebug or lexer::debug) {
+      fprintf (stderr, "Dumping parser::root:\n");
+      if (root != nullptr) root->dump_tree (stderr);
+      fprintf (stderr, "Dumping string_set:\n");
+      string_set::dump (stderr);
+   }
+   if (parse_rc) {
+      // A load that failed has said why.
+      if (not loaded) {
+         errprintf ("%s: parse failed (%d)\n", filename.c_str(),
+                    parse_rc);
+      }
+   }else if (whole) {
+      write_outputs();
+   }
+   if (astree::pool == nullptr) delete root;
+   root = nullptr;
+   nodes.reset();
+   astree::pool = nullptr;
+   string_set::used = nullptr;
+   lex.tokens.clear();
+   exec::captured_out = nullptr;
+   exec::captured_err = nullptr;
+   exit_status = exec::exit_status;
+   exec::exit_status = outer_status;
+}
+
+void compile_unit::write_strings() {
+   if (parse_rc or cached or not (emit & STR)) return;
+   phase_timer timer ("strings", filename);
+   FILE* str_file = open_output (".str");
+   if (str_file == nullptr) {
+      exit_status = EXIT_FAILURE;
+      return;
+   }
+   string_set::dump (str_file, strings);
+   fclose (str_file);
+}
+
+void compile_unit::store_cache() {
+   if (cached or cache_key.empty()) return;
+   phase_timer timer ("cache", filename);
+   captured.exit_status = exit_status;
+   compile_cache::store (cache_key, artifacts, captured);
+}
+
@@ -0,0 +1,85 @@
+#ifndef __COMPILE_UNIT_H__
+#define __COMPILE_UNIT_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <stdio.h>
+
+#include "astree.h"
+#include "compile_cache.h"
+#include "emitter.h"
+#include "lyutils.h"
+
+//
+// DESCRIPTION
+//    State belonging to the compilation of a single .oc file:
+//    its name, its syntax tree, its output files and its exit
+//    status.  Several units may be compiled at once in batch mode.
+//
+
+struct compile_unit {
+   enum artifact : unsigned {
+      STR = 1 << 0, TOK = 1 << 1, AST = 1 << 2, SYM = 1 << 3,
+      OIL = 1 << 4, ALL = STR | TOK | AST | SYM | OIL,
+      ASTB = 1 << 5,         // only when named in --emit
+   };
+   static unsigned emit;     // artifacts to write, set by --emit
+   static bool streaming;    // write each top-level item as parsed
+   static bool token_thread; // format the .tok file on its own thread
+   static bool parse_emit (const string& list);
+   // Sets emit from a list like "oil,sym"; false if it is bad.
+
+   string filename;          // source file named on the command line
+   bool loaded;              // filename is a .astb file to load
+   string stem;              // filename without its .oc suffix
+   astree* root;             // syntax tree built by the parser
+   int parse_rc;             // yyparse return code
+   int exit_status;          // EXIT_SUCCESS unless an error occurred
+   lexer lex;                // scanner state and included file names
+   node_pool nodes;          // holds the syntax tree
+   vector<bool> strings;     // ids of the strings it interned
+   vector<string> artifacts; // output files written
+
+   compile_unit (const string& filename, bool loaded = false);
+   ~compile_unit();
+   void compile();
+   // Runs the preprocessor, scanner and parser, then writes
+   // whichever of the .tok, .ast, .sym and .oil files are in emit.
+
+   void write_strings();
+   // Writes the .str file, listing the strings this unit interned,
+   // if it is in emit.
+
+   void store_cache();
+   // Saves the outputs in the compile cache after a miss.
+
+   private:
+   string cpp_command;
+   string cache_key;         // set when the cache was consulted
+   bool cached;              // outputs came from the cache
+   compile_cache::entry captured;
+   FILE* tok_stream;         // output files open while streaming
+   FILE* ast_stream;
+   FILE* sym_stream;
+   FILE* oil_stream;
+   unique_ptr<emitter> oil_code;  // emits each item to oil_stream
+   FILE* cpp_popen();
+   void cpp_pclose (FILE* pipe);
+   bool read_source (string& text);
+   void parse();
+   void load();
+   void parse_text (string& text);
+   int run_parser (parser& state);
+   void open_streams();
+   void stream_item (astree* item);
+   void close_streams (bool keep);
+   bool fetch_cached();
+   void write_outputs();
+   FILE* open_output (const char* suffix);
+};
+
+#endif
+
@@ -1,406 +1,367 @@
+#include <algorithm>
+#include <deque>
+#include <string>
+using namespace std;
+
 #include <assert.h>
 #include <stdio.h>
-#include <string.h>
 
 #include "astree.h"
 #include "emitter.h"
 #include "auxlib.h"
 #include "lyutils.h"
-extern FILE* oil_file;
-
-using namespace std;
-
-void emit (astree* root);
+#include "thread_pool.h"
+#include "visitor.h"
 
-int sn = 0;
-int tn = 0;
-int whn = 0;
-int ifn = 0;
-int loc_flag = 0;
-string header = "";
+//returns a node's lexinfo, without copying it
+string_view get_str(astree* tree) {
+   return tree->lexinfo->view();
+}
 
-//returns a node's lexinfo as a string
-string get_str(astree* tree) {
-   return tree->lexinfo->c_str();
+//True if postorder_emit_oper computes tree into a temporary
+static bool is_oper (astree* tree) {
+   return tree->children.size() == 2 && tree->symbol != TOK_ARROW;
 }
 
-//returns an identifier string
-string get_ident(astree* tree) {
+//Appends an identifier
+void emitter::write_ident(astree* tree) {
    if(tree->symbol == TOK_ARROW)
-      return get_str(tree->children.at(0)) + "->" + 
-             get_str(tree->children.at(1));
+      out.text(get_str(tree->children.at(0))).text("->")
+         .text(get_str(tree->children.at(1)));
 
    else
-      return get_str(tree);
+      out.text(get_str(tree));
+}
+
+//Appends the condition of a goto that leaves a loop or an if
+void emitter::write_branch(astree* cond) {
+   if(cond->symbol == TOK_EQ){
+      write_ident(cond->children.at(0));
+      out.text(" != ");
+      write_ident(cond->children.at(1));
+   }
+   else if(cond->symbol == TOK_NE){
+      write_ident(cond->children.at(0));
+      out.text(" == ");
+      write_ident(cond->children.at(1));
+   }
+   else if(cond->symbol == TOK_NOT)
+      out.text(get_str(cond->children.at(0)));
+
+   else{
+      out.text("not ").temp(tn);
+      tn ++;
+   }
 }
 
 //Prints all code in the correct place
-void emit_insn (const char* opcode, const char* operand) {
-   fprintf (oil_file, "%-10s%s %s\n", header.c_str(), opcode, operand);
-   header = "";
+void emitter::emit_insn (const char* opcode, const char* operand) {
+   out.start().text(opcode).text(" ").text(operand).end();
 }
 
-//Prints the start of emitter code
-void emit_start (const char* opcode){
-   fprintf(oil_file, "%s:", opcode);
+//True if emit writes only the code of tree's children
+static bool emits_children (astree* tree) {
+   switch (tree->symbol) {
+      case TOK_BLOCK: case TOK_TYPEID: case TOK_ARROW:
+      case TOK_FIELD: case '{': case TOK_ALLOC: case TOK_ARRAY:
+      case TOK_ELSE: case TOK_NE: case TOK_NULLPTR: case TOK_INDEX:
+      case ';':
+         return true;
+      default:
+         return false;
+   }
 }
 
-//Posorder search algorithm provided by Wesley Mackey
-void postorder (astree* tree) {
+//Posorder search algorithm provided by Wesley Mackey.  Children
+//that would only emit their own children are walked through
+//instead of recursed into, so deep index chains are safe.
+void emitter::postorder (astree* tree) {
    assert (tree != nullptr);
-   for (size_t child = 0; child < tree->children.size(); ++child) {
-      emit (tree->children.at(child));
-   }
+   astree::walk (tree, [this] (astree* node, int depth) {
+      if (depth == 0 or emits_children (node)) return true;
+      emit (node);
+      return false;
+   }, [] (astree*) {});
 }
 
 //default stmnt parser
-void postorder_emit_stmts (astree* tree) {
+void emitter::postorder_emit_stmts (astree* tree) {
    postorder (tree);
 }
 
 //Default block parser
-void postorder_emit_block (astree* tree) {
-   postorder(tree); 
+void emitter::postorder_emit_block (astree* tree) {
+   postorder(tree);
 }
 
 //Handles function calls
-void postorder_emit_call (astree* tree) {
+void emitter::postorder_emit_call (astree* tree) {
    assert (tree != nullptr);
-   string func_name = get_str(tree->children.at(0));
-   string start =  "call " + func_name + " (";
-   for(size_t child = 1; child < tree->children.size(); ++child) {
-      string arg = get_ident(tree->children.at(child));
-      if(child == tree->children.size() - 1)
-         start.append(arg + ")");
+   out.start().text("call ").text(get_str(tree->children.at(0)))
+      .text(" (");
+   auto child = ++tree->children.begin();
+   while(child != tree->children.end()) {
+      write_ident(*child);
+      if(++child == tree->children.end())
+         out.text(")");
       else
-         start.append(arg + ", ");
+         out.text(", ");
    }
 
-   emit_insn(start.c_str(), "");
+   out.text(" ").end();
 }
 
 //Handles all comparison fucntions
-void postorder_emit_compare(astree* tree) {
+void emitter::postorder_emit_compare(astree* tree) {
    if(tree->symbol == TOK_EQ || tree->symbol == TOK_NE)
       return;
    else if(tree->symbol == TOK_NOT)
       return;
-   string temp_reg = "$t" + to_string(tn) + ":i"; 
-   string cmp =
-   get_str(tree->children.at(0)) + " " +
-   get_str(tree) + " " + get_str(tree->children.at(1));
-   string line = temp_reg + " = " + cmp;
-   emit_insn(line.c_str(), "");
+   out.start().temp(tn).text(" = ")
+      .text(get_str(tree->children.at(0))).text(" ")
+      .text(get_str(tree)).text(" ")
+      .text(get_str(tree->children.at(1))).text(" ").end();
 }
 
 //Handles functions
-void postorder_emit_func (astree* tree) {
+void emitter::postorder_emit_func (astree* tree) {
    assert (tree != nullptr);
    loc_flag = 1;
-   string func_ident = get_str(tree->children.at(0)->children.at(0));
-   string func_type = get_str(tree->children.at(0));
-   if(strcmp(func_type.c_str(), "void") == 0)
-      func_type = "";
-
-   func_ident.append(":");
-   header = func_ident;
-   emit_insn(".function", func_type.c_str());
-   for(size_t child = 1; child < tree->children.size(); ++child) {
-      emit (tree->children.at(child));
+   string_view func_type = get_str(tree->children.at(0));
+   out.label(get_str(tree->children.at(0)->children.at(0)));
+   out.start().text(".function ");
+   if(func_type != "void")
+      out.text(func_type);
+   out.end();
+   auto child = ++tree->children.begin();
+   for(; child != tree->children.end(); ++child) {
+      emit (*child);
    }
- 
+
    emit_insn("return", "");
    emit_insn(".end", "");
    loc_flag = 0;
 }
 
 //Handles if statments
-void postorder_emit_if(astree* tree){
-   string num = to_string(ifn);
-   header = ".if" + num + ":";
+void emitter::postorder_emit_if(astree* tree){
+   int num = ifn;
+   out.label(".if", num);
    emit(tree->children.at(0));
-   string go;
    if(tree->children.size() == 2){
-      go = "goto .fi" + num + " if ";
-      if(tree->children.at(0)->symbol == TOK_EQ)
-         go += get_ident(tree->children.at(0)->children.at(0)) + 
-              " != " + get_ident(tree->children.at(0)->children.at(1));
-
-      else if(tree->children.at(0)->symbol == TOK_NE)
-         go += get_ident(tree->children.at(0)->children.at(0)) + 
-              " == " + get_ident(tree->children.at(0)->children.at(1));
+      out.start().text("goto .fi").number(num).text(" if ");
+      write_branch(tree->children.at(0));
+      out.text(" ").end();
 
-      else if(tree->children.at(0)->symbol == TOK_NOT)
-         go += get_str(tree->children.at(0)->children.at(0));
-
-      else{
-         go += "not $t" + to_string(tn) +":i";
-         tn ++;
-      }
-
-      emit_insn(go.c_str(), "");
-
-      header = ".th" + num + ":";
+      out.label(".th", num);
       emit(tree->children.at(1));
-      header = ".fi" + num + ":";
+      out.label(".fi", num);
    }
    else{
-      go = "goto .el" + num + " if ";
-      if(tree->children.at(0)->symbol == TOK_EQ)
-         go += get_ident(tree->children.at(0)->children.at(0)) + 
-              " != " + get_ident(tree->children.at(0)->children.at(1));
-
-      else if(tree->children.at(0)->symbol == TOK_NE)
-         go += get_ident(tree->children.at(0)->children.at(0)) + 
-              " == " + get_ident(tree->children.at(0)->children.at(1));
-
-      else if(tree->children.at(0)->symbol == TOK_NOT)
-         go += get_str(tree->children.at(0)->children.at(0));
-
-      else{
-         go += "not $t" + to_string(tn) +":i";
+      //The goto to the else part is not written, but its
+      //temporary is still used up.
+      astree* cond = tree->children.at(0);
+      if(cond->symbol != TOK_EQ && cond->symbol != TOK_NE
+         && cond->symbol != TOK_NOT)
          tn ++;
-      }
-      header = ".th" + num + ":";
+      out.label(".th", num);
       emit(tree->children.at(1));
-      emit_insn(("goto .fi" + num).c_str(), "");
-      header = ".el" + num + ":";
+      out.start().text("goto .fi").number(num).text(" ").end();
+      out.label(".el", num);
       emit(tree->children.at(2));
    }
    ++ifn;
 }
 
-//Handles and binary and unary operations
-string postorder_emit_oper(astree* tree) {
+//Handles and binary and unary operations.  Returns the number of
+//the temporary holding the result.  Operands that are operations
+//are computed first, by a walk rather than recursion, and the
+//count of each one's temporary waits in oper_temps.
+int emitter::postorder_emit_oper(astree* tree) {
    assert(tree->children.size() == 2);
-   string lstr;
-   string rstr;
-   int r_check = 0;
-   int l_check = 0;
-   int rtn = 0;
-   int ltn = 0;
-   string temp_reg;
-   string op = get_str(tree);
-   astree* left = tree->children.at(0);
-   astree* right = tree->children.at(1);
-   if(left->children.size() == 2 && left->symbol != TOK_ARROW){
-      ++l_check;
-      lstr = postorder_emit_oper(left);
-      ltn = tn;
-   }
-   else
-      lstr = get_str(left);
-
-   if(right->children.size() == 2 && right->symbol != TOK_ARROW){
-      ++r_check;
-      rstr = postorder_emit_oper(right);
-      rtn = tn;
-   }
-   else
-      rstr = get_ident(right);
-   
-   ++tn;
-   if(r_check == 0 && l_check == 0){
-      temp_reg = 
-      "$t" + to_string(tn-1) + ":i = " + lstr + " " + op + " " + rstr;
-      emit_insn(temp_reg.c_str(), "");
-      return "$t" + to_string(tn-1) + ":i";
-   }
-   else if(r_check == 1 && l_check == 0){
-      temp_reg = "$t" + to_string(tn-1) + ":i = " + lstr +
-                 " " + op + " $t" + to_string(rtn-1) + ":i"; 
-      
-      emit_insn(temp_reg.c_str(), "");
-      return "$t" + to_string(tn-1) + ":i";
-   }
-
-   else if(r_check == 0 && l_check == 1){
-      temp_reg = "$t" + to_string(tn-1) + ":i = $t" +
-                 to_string(ltn-1) + ":i " + op + " " + rstr;
-
-      emit_insn(temp_reg.c_str(), "");
-      return " $t" + to_string(tn-1) + ":i";
-   } 
-
-   temp_reg = "$t" + to_string(tn-1) + ":i = $t" + to_string(ltn-1) +
-               ":i " + op + " $t" + to_string(rtn-1) + ":i"; 
+   auto computes = [tree] (astree* node) {
+      return node == tree || is_oper(node);
+   };
+   astree::walk(tree, [&computes] (astree* node, int) {
+      return computes(node);
+   }, [this, &computes] (astree* node) {
+      if(!computes(node))
+         return;
+      int rtn = 0;
+      int ltn = 0;
+      astree* left = node->children.at(0);
+      astree* right = node->children.at(1);
+      if(is_oper(right)){
+         rtn = oper_temps.back();
+         oper_temps.pop_back();
+      }
+      if(is_oper(left)){
+         ltn = oper_temps.back();
+         oper_temps.pop_back();
+      }
 
-   emit_insn(temp_reg.c_str(), "");
-   return " $t" + to_string(tn-1) + ":i";
+      ++tn;
+      out.start().temp(tn-1).text(" = ");
+      if(ltn != 0)
+         out.temp(ltn-1);
+      else
+         out.text(get_str(left));
+      out.text(" ").text(get_str(node)).text(" ");
+      if(rtn != 0)
+         out.temp(rtn-1);
+      else
+         write_ident(right);
+      out.text(" ").end();
+      oper_temps.push_back(tn);
+   });
+   oper_temps.pop_back();
+   return tn-1;
 }
 
 //Handles parameters
-void postorder_emit_param (astree* tree) {
+void emitter::postorder_emit_param (astree* tree) {
    assert (tree != nullptr);
-   for (size_t child = 0; child < tree->children.size(); ++child) {
-      string param_type = get_str(tree->children.at(child));
-      string param_ident = 
-      get_str(tree->children.at(child)->children.at(0));
-      string temp = param_type + " " + param_ident;
-      emit_insn(".param", temp.c_str());
+   for (astree* param: tree->children) {
+      out.start().text(".param ").text(get_str(param)).text(" ")
+         .text(get_str(param->children.at(0))).end();
    }
 }
 
 //Handles ptr
-void postorder_emit_ptr (astree* tree) {
+void emitter::postorder_emit_ptr (astree* tree) {
    assert(tree != nullptr);
-   string ident = "ptr" + get_str(tree->children.at(1));
-   if (loc_flag == 1)
-      emit_insn(".local", ident.c_str());
-   else
-      emit_insn(".global", ident.c_str());
+   out.start().text(loc_flag == 1 ? ".local ptr" : ".global ptr")
+      .text(get_str(tree->children.at(1))).end();
 }
 
 //Handles returns
-void postorder_emit_return(astree* tree) {
-   string ret_val = get_str(tree->children.at(0));
-   emit_insn("return", ret_val.c_str());
+void emitter::postorder_emit_return(astree* tree) {
+   out.start().text("return ").text(get_str(tree->children.at(0)))
+      .end();
 }
 
 //Handles extra semicolons
-void postorder_emit_semi (astree* tree) {
+void emitter::postorder_emit_semi (astree* tree) {
    postorder (tree);
    return;
 }
 
 //Handles structs
-void postorder_emit_struct(astree* tree) {
-   emit_insn(".struct", tree->children.at(0)->lexinfo->c_str());
+void emitter::postorder_emit_struct(astree* tree) {
+   out.start().text(".struct ").text(get_str(tree->children.at(0)))
+      .end();
    if(tree->children.size() == 2){
       astree* block = tree->children.at(1);
-      for (size_t child = 0; child < block->children.size(); ++child) {
-         string field_type = get_str(block->children.at(child));
-         string field_ident =
-         get_str(block->children.at(child)->children.at(0));
-      
-         string field = field_type + " " + field_ident;
-         emit_insn(".field", field.c_str());
+      for (astree* field: block->children) {
+         out.start().text(".field ").text(get_str(field)).text(" ")
+            .text(get_str(field->children.at(0))).end();
       }
    }
    emit_insn(".end", "");
 }
 
 //Default statement for variables
-void postorder_emit_var (astree* tree, const char* opcode) {
+void emitter::postorder_emit_var (astree* tree, const char* opcode) {
    postorder(tree);
    emit_insn (opcode, "");
 }
 
 //Handles while statements
-void postorder_emit_while (astree* tree) {
-   string num = to_string(whn);
-   string while_head = ".wh" + num + ":";
-   header = while_head;
+void emitter::postorder_emit_while (astree* tree) {
+   int num = whn;
+   out.label(".wh", num);
    emit(tree->children.at(0));
-   string go = "goto .od" + num + " if ";
-   if(tree->children.at(0)->symbol == TOK_EQ)
-      go += get_ident(tree->children.at(0)->children.at(0)) + 
-            " != " + get_ident(tree->children.at(0)->children.at(1));
-
-   else if(tree->children.at(0)->symbol == TOK_NE)
-       go += get_ident(tree->children.at(0)->children.at(0)) + 
-            " == " + get_ident(tree->children.at(0)->children.at(1));
-
-   else if(tree->children.at(0)->symbol == TOK_NOT)
-       go += get_str(tree->children.at(0)->children.at(0));
-
-   else{
-      go += "not $t" + to_string(tn) +":i";
-      tn ++;
-   }
-
-   emit_insn(go.c_str(), "");
-   header = ".do" + num +":";
+   out.start().text("goto .od").number(num).text(" if ");
+   write_branch(tree->children.at(0));
+   out.text(" ").end();
+   out.label(".do", num);
    emit(tree->children.at(1));
-   emit_insn(("goto .wh" + num).c_str(), "");
-   header = ".od" + num + ":";
+   out.start().text("goto .wh").number(num).text(" ").end();
+   out.label(".od", num);
    ++whn;
 }
 
 //Default statement for accepted, but not handled tokens
-void emit_push (astree* tree, const char* opcode) {
-   emit_insn (opcode, tree->lexinfo->c_str());
+void emitter::emit_push (astree* tree, const char* opcode) {
+   out.start().text(opcode).text(" ").text(get_str(tree)).end();
 }
 
 //Handles variable initialization
-void emit_assign (astree* tree) {
+void emitter::emit_assign (astree* tree) {
    assert (tree->children.size() == 2);
    astree* left = tree->children.at(0);
    astree* right = tree->children.at(1);
    if (left->symbol != TOK_IDENT && left->symbol != TOK_ARROW) {
       ;;//do nothing
    }
+   else if(right->children.size() != 0){
+      //The operation is emitted before the assignment is started.
+      int temp = postorder_emit_oper(right);
+      out.start();
+      write_ident(left);
+      out.text(" = ");
+      if(is_oper(right->children.at(0)))
+         out.text(" ");
+      out.temp(temp).end();
+   }
    else {
-      string ident = get_str(left);
-      if(left->children.size() != 0){
-         string var = get_str(left->children.at(0));
-         string field = get_str(left->children.at(1));
-         ident = var + ident + field;  
-      }
-      ident.append(" =");
-      if(right->children.size() != 0){
-         string expr = postorder_emit_oper(right);
-         emit_insn(ident.c_str(), expr.c_str());
-      }
-      else {
-         string val = get_str(right);
-         emit_insn(ident.c_str(), val.c_str());
-      }
+      out.start();
+      write_ident(left);
+      out.text(" = ").text(get_str(right)).end();
    }
 }
 
 //Handles variable declatation
-void emit_vardecl (astree* tree) {
+void emitter::emit_vardecl (astree* tree) {
    assert(tree->children.size() == 2);
    astree* left = tree->children.at(0);
    astree* right = tree->children.at(1);
-   string type = get_str(left);
-   string ident = get_str(left->children.at(0));
-   if(strcmp(type.c_str(), "ptr") == 0)
-      ident = get_str(left->children.at(1));
-   string decl = type + " " + ident;
+   string_view type = get_str(left);
+   astree* ident = left->children.at(0);
+   if(type == "ptr")
+      ident = left->children.at(1);
    if(loc_flag == 1)
-      emit_insn(".local", decl.c_str());
+      out.start().text(".local ").text(type).text(" ")
+         .text(get_str(ident)).end();
    else{
       if(left->symbol == TOK_STRING){
-         header = ".s" + to_string(sn) + ":";
-         emit_insn(get_str(right).c_str(), "");
+         out.label(".s", sn);
+         emit_insn(right->lexinfo->c_str(), "");
          ++sn;
       }
       else
-         header = ident + ":";
+         out.label(get_str(ident));
    }
-      
-   if(strcmp(type.c_str(), "ptr") == 0) {
-      string struct_type = get_str(right->children.at(0));
-      string expr = "malloc " + struct_type;
-      ident.append(" =");
-      emit_insn(ident.c_str(), expr.c_str());
+
+   if(type == "ptr") {
+      out.start().text(get_str(ident)).text(" = malloc ")
+         .text(get_str(right->children.at(0))).end();
    }
    else if(right->children.size() != 0) {
-      ident.append(" =");
-      string expr = postorder_emit_oper(right);
-      emit_insn(ident.c_str(), expr.c_str());
+      int temp = postorder_emit_oper(right);
+      out.start().text(get_str(ident)).text(" = ");
+      if(is_oper(right->children.at(0)))
+         out.text(" ");
+      out.temp(temp).end();
    }
    else {
-      string val = get_str(right);
       if(loc_flag == 0){
-         header = ident + ":";
-         string end = type + " " + val;
-         emit_insn(".global", end.c_str());
+         out.label(get_str(ident));
+         out.start().text(".global ").text(type).text(" ")
+            .text(get_str(right)).end();
       }
       else{
-         ident.append(" =");
-         emit_insn(ident.c_str(), val.c_str());
+         out.start().text(get_str(ident)).text(" = ")
+            .text(get_str(right)).end();
       }
    }
 }
 
 //Formatted switch statement
-void emit (astree* tree) {
+void emitter::emit (astree* tree) {
    switch (tree->symbol) {
-      case TOK_ROOT      : postorder(tree);                    break;
-      case TOK_FUNCTION  : postorder_emit_func(tree);          break;
+      case TOK_ROOT      : emit_program(tree);                 break;
+      case TOK_FUNCTION  : emit_item(tree);                    break;
       case TOK_PROTOTYPE :                                     break;
       case TOK_STRUCT    : postorder_emit_struct(tree);        break;
       case ';'           : postorder_emit_semi (tree);         break;
@@ -447,8 +408,115 @@ void emit (astree* tree) {
    }
 }
 
+size_t emitter::threads = 1;
+
+emitter::emitter (oil_writer& out_):
+         out (out_), sn (0), tn (0), whn (0), ifn (0), loc_flag (0) {
+}
+
+emitter::emitter (FILE* file):
+         own_out (make_unique<oil_writer> (file)), out (*own_out),
+         sn (0), tn (0), whn (0), ifn (0), loc_flag (0) {
+}
+
+void emitter::emit_program (astree* root) {
+   if (threads > 1) {
+      emit_functions (root);
+      return;
+   }
+   for (astree* item: root->children) emit_item (item);
+}
+
+//A function is emitted by an emitter of its own, so that its
+//temporaries start at 0 whatever came before it.
+void emitter::emit_item (astree* item) {
+   if (item->symbol != TOK_FUNCTION) {
+      emit (item);
+      return;
+   }
+   emitter function (out);
+   function.whn = whn;
+   function.ifn = ifn;
+   function.postorder_emit_func (item);
+   whn = function.whn;
+   ifn = function.ifn;
+}
+
+//Counts the while and if labels that emitting a tree will number.
+struct label_counter: visitor<label_counter> {
+   int whiles;
+   int ifs;
+   label_counter (int whiles_, int ifs_): whiles (whiles_),
+                                          ifs (ifs_) {
+   }
+   bool pre (token<TOK_WHILE>, astree*, int) {
+      ++whiles;
+      return true;
+   }
+   bool pre (token<TOK_IF>, astree*, int) {
+      ++ifs;
+      return true;
+   }
+};
+
+//Emits the functions of root on a thread pool, each into a buffer
+//of its own, then writes the items out in order.  Labels are
+//counted first, so each function knows where its numbering starts.
+void emitter::emit_functions (astree* root) {
+   struct function_code {
+      astree* tree;
+      oil_writer out;
+      int whn;
+      int ifn;
+      function_code (astree* tree_, int whn_, int ifn_):
+                     tree (tree_), out (nullptr), whn (whn_),
+                     ifn (ifn_) {
+      }
+   };
+   deque<function_code> functions;
+   label_counter labels (whn, ifn);
+   for (astree* item: root->children) {
+      if (item->symbol == TOK_FUNCTION) {
+         functions.emplace_back (item, labels.whiles, labels.ifs);
+      }
+      visit (item, labels);
+   }
+   if (not functions.empty()) {
+      thread_pool pool (min (threads, functions.size()));
+      for (function_code& function: functions) {
+         function_code* work = &function;
+         pool.submit ([work] {
+            emitter code (work->out);
+            code.whn = work->whn;
+            code.ifn = work->ifn;
+            code.postorder_emit_func (work->tree);
+            work->whn = code.whn;
+            work->ifn = code.ifn;
+         });
+      }
+      pool.wait();
+   }
+   auto function = functions.begin();
+   for (astree* item: root->children) {
+      if (item->symbol != TOK_FUNCTION) {
+         emit (item);
+         continue;
+      }
+      // The function's own label replaces any left pending.
+      out.clear_label();
+      out.append (function->out);
+      whn = function->whn;
+      ifn = function->ifn;
+      ++function;
+   }
+}
+
 //Emits the tree to the oil file
-void emit_sm_code (astree* tree) {
-   printf ("\n");
-   if (tree) emit (tree);
+void emit_sm_code (astree* tree, FILE* outfile) {
+   {
+      oil_writer out (outfile);
+      emitter code (out);
+      if (tree) code.emit_program (tree);
+   }
+   outprintf ("\n");
 }
@@ -1,9 +1,80 @@
 #ifndef __EMIT_H__
 #define __EMIT_H__
 
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <stdio.h>
+
 #include "astree.h"
+#include "oil_writer.h"
+
+//
+// DESCRIPTION
+//    An emitter holds the state of writing the .oil code of one
+//    program: its string, temporary and label counters, and the
+//    oil_writer that formats its instructions.
+//    Each function is emitted by an emitter of its own, with its
+//    temporaries numbered from 0 and its labels numbered on from
+//    those of the items before it.  The functions of a program may
+//    therefore be emitted on several threads into buffers, which
+//    are written out in source order, and the .oil file is the
+//    same whatever the number of threads.
+//
+
+struct emitter {
+   static size_t threads;    // threads emitting functions, from -j
+
+   emitter (oil_writer& out);
+   emitter (FILE* file);
+   // Emits to file through a writer of its own, which is flushed
+   // when the emitter is destroyed.
+
+   void emit_program (astree* root);
+   // Emits each top-level item of root in order.
+
+   void emit_item (astree* item);
+   // Emits one top-level item after those already emitted.
+
+   void emit_insn (const char* opcode, const char* operand);
+   // Writes one instruction, headed by the pending label.
+
+   private:
+   unique_ptr<oil_writer> own_out;  // set when made for a file
+   oil_writer& out;
+   int sn;                   // global strings
+   int tn;                   // temporaries
+   int whn;                  // while labels
+   int ifn;                  // if labels
+   int loc_flag;             // 1 inside a function
+   vector<int> oper_temps;   // results of operands not yet used
+   void emit_functions (astree* root);
+   void emit (astree* tree);
+   void write_ident (astree* tree);
+   void write_branch (astree* cond);
+   void postorder (astree* tree);
+   void postorder_emit_stmts (astree* tree);
+   void postorder_emit_block (astree* tree);
+   void postorder_emit_call (astree* tree);
+   void postorder_emit_compare (astree* tree);
+   void postorder_emit_func (astree* tree);
+   void postorder_emit_if (astree* tree);
+   int postorder_emit_oper (astree* tree);
+   void postorder_emit_param (astree* tree);
+   void postorder_emit_ptr (astree* tree);
+   void postorder_emit_return (astree* tree);
+   void postorder_emit_semi (astree* tree);
+   void postorder_emit_struct (astree* tree);
+   void postorder_emit_var (astree* tree, const char* opcode);
+   void postorder_emit_while (astree* tree);
+   void emit_push (astree* tree, const char* opcode);
+   void emit_assign (astree* tree);
+   void emit_vardecl (astree* tree);
+};
 
-void emit_sm_code (astree*);
+void emit_sm_code (astree*, FILE* oil_file);
 
 #endif
 
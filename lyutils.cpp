@@ -2,86 +2,175 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "auxlib.h"
 #include "lyutils.h"
 
-extern FILE* tok_file;
-
 bool lexer::interactive = true;
-location lexer::lloc = {0, 1, 0};
-size_t lexer::last_yyleng = 0;
-vector<string> lexer::filenames;
+bool lexer::debug = false;
+bool lexer::mapped = false;
+thread_local const lexer* lexer::current = nullptr;
+
+lexer::lexer(): scanner (nullptr), lloc ({0, 1, 0}), last_yyleng (0),
+                text (""), leng (0), map_base (nullptr),
+                map_length (0), log_tokens (false) {
+}
+
+lexer::~lexer() {
+   close();
+   if (current == this) current = nullptr;
+}
+
+void lexer::open (FILE* infile) {
+   assert (scanner == nullptr);
+   yylex_init_extra (this, &scanner);
+   yyset_in (infile, scanner);
+   yyset_debug (debug, scanner);
+}
+
+//Scans preprocessed text held in memory rather than a file.
+//Flex scans the string in place, so it must not be touched until
+//the lexer is closed.  Two NUL bytes are appended as flex requires.
+void lexer::open (string& source) {
+   assert (scanner == nullptr);
+   yylex_init_extra (this, &scanner);
+   yyset_debug (debug, scanner);
+   source.append (2, '\0');
+   yy_scan_buffer (&source[0], source.size(), scanner);
+}
+
+//Maps the file privately and scans it in place.  The file is mapped
+//over an anonymous zero-filled region one page or more longer, so
+//the two NUL bytes flex needs after the text are always there.
+bool lexer::open_mapped (const string& filename) {
+   assert (scanner == nullptr);
+   int fd = ::open (filename.c_str(), O_RDONLY);
+   if (fd < 0) return false;
+   struct stat info;
+   if (fstat (fd, &info) != 0) {
+      ::close (fd);
+      return false;
+   }
+   size_t size = info.st_size;
+   size_t pagesize = sysconf (_SC_PAGESIZE);
+   map_length = (size + 2 + pagesize - 1) / pagesize * pagesize;
+   void* base = mmap (nullptr, map_length, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (base != MAP_FAILED and size > 0
+   and mmap (base, size, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+      munmap (base, map_length);
+      base = MAP_FAILED;
+   }
+   ::close (fd);
+   if (base == MAP_FAILED) return false;
+   map_base = static_cast<char*> (base);
+   yylex_init_extra (this, &scanner);
+   yyset_debug (debug, scanner);
+   yy_scan_buffer (map_base, size + 2, scanner);
+   return true;
+}
 
-astree* parser::root = nullptr;
+void lexer::close() {
+   if (scanner != nullptr) yylex_destroy (scanner);
+   scanner = nullptr;
+   if (map_base != nullptr) munmap (map_base, map_length);
+   map_base = nullptr;
+   map_length = 0;
+}
 
-const string* lexer::filename (int filenr) {
-   return &lexer::filenames.at(filenr);
+const string* lexer::filename (int filenr) const {
+   return &filenames.at(filenr);
 }
 
 void lexer::newfilename (const string& filename) {
-   lexer::lloc.filenr = lexer::filenames.size();
-   lexer::filenames.push_back (filename);
+   lloc.filenr = filenames.size();
+   filenames.push_back (filename);
 }
 
-void lexer::advance() {
+void lexer::advance (const char* text_, size_t leng_) {
+   text = text_;
+   leng = leng_;
    if (not interactive) {
-      if (lexer::lloc.offset == 0) {
-         printf (";%2zd.%3zd: ",
-                 lexer::lloc.filenr, lexer::lloc.linenr);
+      if (lloc.offset == 0) {
+         outprintf (";%2u.%3u: ", lloc.filenr, lloc.linenr);
       }
-      printf ("%s", yytext);
+      outprintf ("%s", text);
    }
-   lexer::lloc.offset += last_yyleng;
-   last_yyleng = yyleng;
+   lloc.offset += last_yyleng;
+   last_yyleng = leng;
 }
 
 void lexer::newline() {
-   ++lexer::lloc.linenr;
-   lexer::lloc.offset = 0;
+   ++lloc.linenr;
+   lloc.offset = 0;
 }
 
 void lexer::badchar (unsigned char bad) {
    char buffer[16];
    snprintf (buffer, sizeof buffer,
              isgraph (bad) ? "%c" : "\\%03o", bad);
-   errllocprintf (lexer::lloc, "invalid source character (%s)\n",
+   errllocprintf (lloc, "invalid source character (%s)\n",
                   buffer);
 }
 
 void lexer::include() {
    size_t linenr;
-   static char filename[0x1000];
-   assert (sizeof filename > strlen (yytext));
-   int scan_rc = sscanf (yytext, "# %zu \"%[^\"]\"", &linenr, filename);
+   char filename[0x1000];
+   assert (sizeof filename > strlen (text));
+   int scan_rc = sscanf (text, "# %zu \"%[^\"]\"", &linenr, filename);
    if (scan_rc != 2) {
-      errprintf ("%s: invalid directive, ignored\n", yytext);
+      errprintf ("%s: invalid directive, ignored\n", text);
    }else {
-      if (yy_flex_debug) {
+      if (debug) {
          fprintf (stderr, "--included # %zd \"%s\"\n",
                   linenr, filename);
       }
 
-      lexer::lloc.linenr = linenr - 1;
-      lexer::newfilename (filename);
+      lloc.linenr = linenr - 1;
+      newfilename (filename);
    }
 }
 
-int lexer::token (int symbol) {
-   yylval = new astree (symbol, lexer::lloc, yytext);
+int lexer::token (YYSTYPE* yylval, int symbol) {
+   *yylval = new astree (symbol, lloc,
+                         string_set::intern (text, leng));
+   if (log_tokens) tokens.append (symbol, lloc, (*yylval)->lexinfo);
    return symbol;
 }
 
-int lexer::badtoken (int symbol) {
-   errllocprintf (lexer::lloc, "invalid token (%s)\n", yytext);
-   return lexer::token (symbol);
+int lexer::badtoken (YYSTYPE* yylval, int symbol) {
+   errllocprintf (lloc, "invalid token (%s)\n", text);
+   return token (yylval, symbol);
+}
+
+parser::parser (lexer& lex_): lex (lex_), root (nullptr) {
+}
+
+int parser::parse() {
+   return yyparse (*this);
+}
+
+astree* parser::top_level (astree* program, astree* item) {
+   if (not consume) return program->adopt (item);
+   consume (item);
+   delete item;
+   return program;
+}
+
+int yylex (YYSTYPE* yylval, parser& state) {
+   return yylex (yylval, state.lex.scanner);
 }
 
-void yyerror (const char* message) {
-   assert (not lexer::filenames.empty());
-   errllocprintf (lexer::lloc, "%s\n", message);
+void yyerror (parser& state, const char* message) {
+   assert (not state.lex.filenames.empty());
+   errllocprintf (state.lex.lloc, "%s\n", message);
 }
 
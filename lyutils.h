@@ -4,8 +4,13 @@
 #define __UTILS_H__
 
 // Lex and Yacc interface utility.
+// The scanner is a reentrant flex scanner and the parser is a pure
+// bison parser, so all of their state lives in a lexer and a parser
+// object and several files may be parsed at the same time.
 
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 using namespace std;
 
@@ -13,43 +18,86 @@ using namespace std;
 
 #include "astree.h"
 #include "auxlib.h"
+#include "token_log.h"
 
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void* yyscan_t;
+#endif
 
-#define YYEOF 0
+#define YYSTYPE_IS_DECLARED
+typedef astree* YYSTYPE;
 
-extern FILE* yyin;
-extern char* yytext; 
-extern int yy_flex_debug;
 extern int yydebug;
-extern int yyleng; 
 
-int yylex();
-int yylex_destroy();
-int yyparse();
-void yyerror (const char* message);
+struct lexer;
+struct parser;
+struct yy_buffer_state;
+
+int yylex_init_extra (lexer* extra, yyscan_t* scanner);
+int yylex_destroy (yyscan_t scanner);
+void yyset_in (FILE* infile, yyscan_t scanner);
+yy_buffer_state* yy_scan_buffer (char* base, size_t size,
+                                 yyscan_t scanner);
+void yyset_debug (int flag, yyscan_t scanner);
+int yylex (YYSTYPE* yylval, yyscan_t scanner);
+int yylex (YYSTYPE* yylval, parser& state);
+int yyparse (parser& state);
+void yyerror (parser& state, const char* message);
 
 struct lexer {
-   static bool interactive;
-   static location lloc;
-   static size_t last_yyleng;
-   static vector<string> filenames;
-   static const string* filename (int filenr);
-   static void newfilename (const string& filename);
-   static void advance();
-   static void newline();
-   static void badchar (unsigned char bad);
-   static void include();
-   static int token (int symbol);
-   static int badtoken (int symbol);
+   static bool interactive;  // echo source to stdout when false
+   static bool debug;        // flex trace (-l)
+   static bool mapped;       // scan the mmapped source, no cpp (-m)
+   static thread_local const lexer* current;  // for errllocprintf
+
+   yyscan_t scanner;
+   location lloc;
+   size_t last_yyleng;
+   const char* text;         // yytext of the rule being matched
+   size_t leng;              // yyleng of the rule being matched
+   vector<string> filenames;
+   char* map_base;           // mapping made by open_mapped
+   size_t map_length;
+   bool log_tokens;          // append each token to tokens
+   token_log tokens;
+
+   lexer();
+   ~lexer();
+   lexer (const lexer&) = delete;
+   lexer& operator= (const lexer&) = delete;
+   void open (FILE* infile);
+   void open (string& source);
+   bool open_mapped (const string& filename);
+   void close();
+   string_view lexeme() const { return {text, leng}; }
+   // The current lexeme.  After open (string&) or open_mapped it
+   // points into the scanned buffer itself.
+
+   const string* filename (int filenr) const;
+   void newfilename (const string& filename);
+   void advance (const char* text, size_t leng);
+   void newline();
+   void badchar (unsigned char bad);
+   void include();
+   int token (YYSTYPE* yylval, int symbol);
+   int badtoken (YYSTYPE* yylval, int symbol);
 };
 
 struct parser {
-   static astree* root;
+   lexer& lex;
+   astree* root;
+   function<void (astree*)> consume;
+   // When set, each top-level structdef, function and statement is
+   // passed to consume as soon as it is parsed, then deleted,
+   // instead of being adopted by root.
+
+   parser (lexer& lex);
+   int parse();
+   astree* top_level (astree* program, astree* item);
    static const char* get_tname (int symbol);
 };
 
-#define YYSTYPE_IS_DECLARED
-typedef astree* YYSTYPE;
 #include "yyparse.h"
 #endif
 
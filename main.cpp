@@ -1,12 +1,16 @@
 // $Id: main.cpp,v 1.18 2017-10-19 16:02:14-07 - - $
 
+#include <algorithm>
+#include <memory>
 #include <string>
 #include <vector>
 #include <iostream>
 using namespace std;
 
 #include <assert.h>
+#include <ctype.h>
 #include <errno.h>
+#include <getopt.h>
 #include <libgen.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,114 +19,253 @@ using namespace std;
 
 #include "astree.h"
 #include "auxlib.h"
+#include "compile_cache.h"
+#include "compile_unit.h"
 #include "emitter.h"
 #include "lyutils.h"
-#include "string_set.h"
+#include "phase_timer.h"
+#include "preprocessor.h"
+#include "server.h"
+#include "thread_pool.h"
 
-const string cpp_name = "/usr/bin/cpp";
-string cpp_command;
-FILE* tok_file;
-FILE* oil_file;
+// Batch compilation uses a thread pool of this many workers.
+size_t nthreads = 1;
 
-// Open a pipe from the C preprocessor.
-// Exit failure if can't.
-// Assigns opened pipe to FILE* yyin.
-void cpp_popen (const char* filename) {
-   cpp_command = cpp_name + " " + filename;
-   yyin = popen (cpp_command.c_str(), "r");
-   if (yyin == nullptr) {
-      syserrprintf (cpp_command.c_str());
-      exit (exec::exit_status);
-   }else {
-      if (yy_flex_debug) {
-         fprintf (stderr, "-- popen (%s), fileno(yyin) = %d\n",
-                  cpp_command.c_str(), fileno (yyin));
-      }
-      lexer::newfilename (cpp_command);
-   }
-}
+// With -E, files are only preprocessed, to stdout.
+bool preprocess_only = false;
+
+// With --cache-stats, the compile cache statistics are printed.
+bool cache_stats = false;
 
-void cpp_pclose() {
-   int pclose_rc = pclose (yyin);
-   eprint_status (cpp_command.c_str(), pclose_rc);
-   if (pclose_rc != 0) exec::exit_status = EXIT_FAILURE;
+// Trees to compile from .astb files, named by --load-ast.
+vector<string> ast_inputs;
+
+enum long_only_option {
+   CACHE = 256, CACHE_SIZE, CACHE_STATS, EMIT, LOAD_AST, STREAM,
+   TIME_REPORT, TRACE,
+};
+const struct option long_options[] {
+   {"cache",       required_argument, nullptr, CACHE      },
+   {"cache-size",  required_argument, nullptr, CACHE_SIZE },
+   {"cache-stats", no_argument,       nullptr, CACHE_STATS},
+   {"emit",        required_argument, nullptr, EMIT       },
+   {"load-ast",    required_argument, nullptr, LOAD_AST   },
+   {"stream",      no_argument,       nullptr, STREAM     },
+   {"time-report", optional_argument, nullptr, TIME_REPORT},
+   {"trace",       required_argument, nullptr, TRACE      },
+   {nullptr,       0,                 nullptr, 0          },
+};
+
+//Sets nthreads from the argument of -j, a count of at least 1.
+void scan_threads (const char* count) {
+   char* end = nullptr;
+   errno = 0;
+   unsigned long threads = strtoul (count, &end, 10);
+   if (not isdigit (static_cast<unsigned char> (count[0]))
+    or *end != '\0' or errno != 0 or threads < 1) {
+      errprintf ("%:-j%s: expected a thread count of at least 1\n",
+                 count);
+      return;
+   }
+   nthreads = threads;
 }
 
-
-void scan_opts (int argc, char** argv) {
+// Options are reset on every call, since a compile server runs
+// many command lines in one process.
+vector<string> scan_opts (int argc, char** argv) {
    opterr = 0;
-   yy_flex_debug = 0;
+   optind = 0;
+   nthreads = 1;
+   preprocess_only = false;
+   cache_stats = false;
+   ast_inputs.clear();
+   const char* cache_dir = getenv ("OC_CACHE_DIR");
+   compile_cache::directory = cache_dir == nullptr ? "" : cache_dir;
+   compile_cache::max_size = size_t (256) << 20;
+   compile_unit::emit = compile_unit::ALL;
+   compile_unit::streaming = false;
+   phase_timer::reset();
+   set_debugflags ("");
+   lexer::debug = false;
+   lexer::mapped = false;
+   preprocessor::builtin = false;
    yydebug = 0;
-   lexer::interactive = isatty (fileno (stdin))
-                    and isatty (fileno (stdout));
    for(;;) {
-      int opt = getopt (argc, argv, "@:ly");
+      int opt = getopt_long (argc, argv, "@:Ef:j:lmpy",
+                             long_options, nullptr);
       if (opt == EOF) break;
       switch (opt) {
+         case CACHE:
+            compile_cache::directory = optarg;
+            break;
+         case CACHE_SIZE:
+            compile_cache::max_size = strtoull (optarg, nullptr, 10)
+                                    << 20;
+            break;
+         case CACHE_STATS:
+            cache_stats = true;
+            break;
+         case EMIT:
+            if (not compile_unit::parse_emit (optarg)) {
+               errprintf ("%:--emit=%s: expected a list of str, tok,"
+                          " ast, sym, oil and astb\n", optarg);
+            }
+            break;
+         case LOAD_AST:
+            ast_inputs.push_back (optarg);
+            break;
+         case STREAM:
+            compile_unit::streaming = true;
+            break;
+         case TIME_REPORT:
+            phase_timer::report = true;
+            if (optarg == nullptr) break;
+            if (strcmp (optarg, "counters") == 0) {
+               phase_timer::counters = true;
+            }else {
+               errprintf ("%:--time-report=%s: expected counters\n",
+                          optarg);
+            }
+            break;
+         case TRACE:
+            phase_timer::trace_file = optarg;
+            break;
+         case 'f':
+            if (strcmp (optarg, "syntax-only") == 0) {
+               compile_unit::emit = 0;
+            }else {
+               errprintf ("%:-f%s: unknown option\n", optarg);
+            }
+            break;
          case '@': set_debugflags (optarg);   break;
-         case 'l': yy_flex_debug = 1;         break;
+         case 'E': preprocess_only = true;    break;
+         case 'j': scan_threads (optarg);     break;
+         case 'l': lexer::debug = true;       break;
+         case 'm': lexer::mapped = true;      break;
+         case 'p': preprocessor::builtin = true; break;
          case 'y': yydebug = 1;               break;
          default:  errprintf ("bad option (%c)\n", optopt); break;
       }
    }
-   if (optind > argc) {
-      errprintf ("Usage: %s [-ly] [filename]\n",
-                 exec::execname.c_str());
-      exit (exec::exit_status);
+   // A streamed tree is freed as it is parsed, so there is no
+   // whole tree to write to a .astb file.
+   bool astb = compile_unit::emit & compile_unit::ASTB;
+   if (compile_unit::streaming and astb) {
+      errprintf ("%:--stream cannot be used with --emit=astb\n");
+   }
+   vector<string> filenames (&argv[optind], &argv[argc]);
+   if (filenames.empty() and ast_inputs.empty() and not cache_stats) {
+      filenames.push_back ("-");
    }
-   const char* filename = optind == argc ? "-" : argv[optind];
-   cpp_popen (filename);
+   return filenames;
 }
 
-int main (int argc, char** argv) {
-   exec::execname = basename (argv[0]);
-   if (yydebug or yy_flex_debug) {
+int compile_main (int argc, char** argv, vector<string>* artifacts) {
+   vector<string> filenames = scan_opts (argc, argv);
+   // Errors in the options fail the run, whatever the units do.
+   int options_status = exec::exit_status;
+   // Only now are the flags those of this command line.
+   if (yydebug or lexer::debug) {
       fprintf (stderr, "Command:");
       for (char** arg = &argv[0]; arg < &argv[argc]; ++arg) {
             fprintf (stderr, " %s", *arg);
       }
       fprintf (stderr, "\n");
    }
-   scan_opts (argc, argv);
-   int parse_rc = yyparse();
-   cpp_pclose();
-   yylex_destroy();
-   if (yydebug or yy_flex_debug) {
-      fprintf (stderr, "Dumping parser::root:\n");
-      if (parser::root != nullptr) parser::root->dump_tree (stderr);
-      fprintf (stderr, "Dumping string_set:\n");
-      string_set::dump (stderr);
+   if (preprocess_only) {
+      for (const string& filename: filenames) {
+         string text;
+         preprocessor cpp;
+         if (cpp.run (filename, text)) {
+            fwrite (text.data(), 1, text.size(), stdout);
+         }
+      }
+      return exec::exit_status;
    }
-   if (parse_rc) {
-      errprintf ("parse failed (%d)\n", parse_rc);
+   vector<unique_ptr<compile_unit>> units;
+   for (const string& filename: filenames) {
+      units.push_back (make_unique<compile_unit> (filename));
+   }
+   for (const string& filename: ast_inputs) {
+      units.push_back (make_unique<compile_unit> (filename, true));
+   }
+   // A single file has the threads to itself for its functions.
+   // With -j, each unit writes its .tok file on a thread of its own.
+   emitter::threads = units.size() == 1 ? nthreads : 1;
+   compile_unit::token_thread = nthreads > 1;
+   if (nthreads <= 1 or units.size() == 1) {
+      for (auto& unit: units) unit->compile();
    }else {
-      string fn = argv[argc-1]; 
-      fn = fn.substr(0, fn.size() - 3);
-      string str = fn + ".str";
-      string tok = fn + ".tok";
-      string ast = fn + ".ast";
-      string sym = fn + ".sym";
-      string oil = fn + ".oil";
-      FILE* str_file = fopen(str.c_str(), "w");
-      tok_file = fopen(tok.c_str(), "w");
-      FILE* ast_file = fopen(ast.c_str(), "w");
-      FILE* sym_file = fopen(sym.c_str(), "w");
-      oil_file = fopen(oil.c_str(), "w");
-
-      string_set::dump(str_file);
-      fprintf(tok_file, "# \"%s\"\n", argv[argc-1]);
-      astree::print (ast_file, parser::root); 
-     /* symbol_generator* generator = new symbol_generator(sym_file);
-      generator->traverse(parser::root);*/
-      emit_sm_code(parser::root);
-      delete parser::root;
-
-      pclose(str_file);
-      pclose(tok_file);
-      pclose(ast_file);
-      pclose(sym_file);
-      pclose(oil_file);
+      thread_pool pool (min (nthreads, units.size()));
+      for (auto& unit: units) {
+         compile_unit* work = unit.get();
+         pool.submit ([work] { work->compile(); });
+      }
+      pool.wait();
+   }
+   // Each .str file lists just the strings its unit interned.
+   for (auto& unit: units) {
+      unit->write_strings();
+      unit->store_cache();
+      if (artifacts != nullptr) {
+         artifacts->insert (artifacts->end(), unit->artifacts.begin(),
+                            unit->artifacts.end());
+      }
+      if (unit->exit_status != EXIT_SUCCESS) {
+         exec::exit_status = EXIT_FAILURE;
+      }
+   }
+   if (phase_timer::report) phase_timer::print_report (stderr);
+   if (not phase_timer::trace_file.empty()) {
+      if (phase_timer::write_trace() and artifacts != nullptr) {
+         artifacts->push_back (phase_timer::trace_file);
+      }
+   }
+   if (cache_stats) {
+      if (compile_cache::enabled()) {
+         compile_cache::print_stats (stdout);
+      }else {
+         errprintf ("%:no cache directory\n");
+      }
+   }
+   if (options_status != EXIT_SUCCESS) {
+      exec::exit_status = EXIT_FAILURE;
    }
    return exec::exit_status;
 }
 
+void usage() {
+   errprintf ("Usage: %s [-Elmpy] [-j threads] [-fsyntax-only]\n"
+              "          [--emit=str,tok,ast,sym,oil,astb] [--stream]"
+              " [--cache=dir]\n"
+              "          [--cache-size=MiB] [--cache-stats]"
+              " [--load-ast=file.astb]\n"
+              "          [--time-report[=counters]] [--trace=file.json]"
+              " [filename...]\n"
+              "       %s --server socket\n"
+              "       %s --client socket [options] [filename...]\n",
+              exec::execname.c_str(), exec::execname.c_str(),
+              exec::execname.c_str());
+}
+
+int main (int argc, char** argv) {
+   exec::execname = basename (argv[0]);
+   if (argc > 1 and (strcmp (argv[1], "--server") == 0
+                  or strcmp (argv[1], "--client") == 0)) {
+      if (argc < 3) {
+         usage();
+      }else if (strcmp (argv[1], "--server") == 0) {
+         return compile_server::serve (argv[2]);
+      }else {
+         // Forward the rest of the command line as if it were ours.
+         const char* socket_path = argv[2];
+         argv[2] = argv[0];
+         return compile_server::request (socket_path,
+                                         argc - 2, argv + 2);
+      }
+      return exec::exit_status;
+   }
+   lexer::interactive = isatty (fileno (stdin))
+                    and isatty (fileno (stdout));
+   return compile_main (argc, argv);
+}
@@ -0,0 +1,84 @@
+#include <mutex>
+#include <new>
+#include <vector>
+using namespace std;
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "node_pool.h"
+
+static constexpr size_t MAX_CHUNKS =
+       (size_t (1) << (32 - node_pool::CHUNK_BITS)) - 1;
+
+char* node_pool::chunk_table[MAX_CHUNKS + 1];
+
+static mutex chunk_lock;
+static vector<uint32_t> spare_chunks;  // given back by a pool
+static size_t chunk_count = 0;
+
+//Reuses a chunk some pool gave back, or maps a new one and
+//writes its number into slot 0.
+static uint32_t take_chunk (char** chunk_table) {
+   lock_guard<mutex> lock (chunk_lock);
+   if (not spare_chunks.empty()) {
+      uint32_t chunk = spare_chunks.back();
+      spare_chunks.pop_back();
+      return chunk;
+   }
+   if (chunk_count == MAX_CHUNKS) throw bad_alloc();
+   void* memory = aligned_alloc (node_pool::CHUNK_SIZE,
+                                 node_pool::CHUNK_SIZE);
+   if (memory == nullptr) throw bad_alloc();
+   uint32_t chunk = static_cast<uint32_t> (chunk_count++);
+   *static_cast<uint32_t*> (memory) = chunk;
+   chunk_table[chunk] = static_cast<char*> (memory);
+   return chunk;
+}
+
+static void give_chunks (vector<uint32_t>::const_iterator begin,
+                         vector<uint32_t>::const_iterator end) {
+   lock_guard<mutex> lock (chunk_lock);
+   spare_chunks.insert (spare_chunks.end(), begin, end);
+}
+
+node_pool::node_pool(): next (NO_NODE), limit (NO_NODE),
+                        free_slots (nullptr), live (0) {
+}
+
+node_pool::~node_pool() {
+   give_chunks (chunks.begin(), chunks.end());
+}
+
+void* node_pool::allocate() {
+   ++live;
+   if (free_slots != nullptr) {
+      void* slot = free_slots;
+      free_slots = *static_cast<void**> (slot);
+      return slot;
+   }
+   if (next == limit) {
+      uint32_t chunk = take_chunk (chunk_table);
+      chunks.push_back (chunk);
+      next = chunk << CHUNK_BITS | 1;
+      limit = next + CHUNK_NODES - 1;
+   }
+   return slot (next++);
+}
+
+void node_pool::release (void* slot) {
+   --live;
+   *static_cast<void**> (slot) = free_slots;
+   free_slots = slot;
+}
+
+void node_pool::reset() {
+   free_slots = nullptr;
+   live = 0;
+   if (chunks.empty()) return;
+   give_chunks (chunks.begin() + 1, chunks.end());
+   chunks.resize (1);
+   next = chunks.front() << CHUNK_BITS | 1;
+   limit = next + CHUNK_NODES - 1;
+}
+
@@ -0,0 +1,66 @@
+#ifndef __NODE_POOL_H__
+#define __NODE_POOL_H__
+
+#include <cstddef>
+#include <vector>
+using namespace std;
+
+#include <stdint.h>
+
+//
+// DESCRIPTION
+//    Fixed-size slots for syntax tree nodes, named by 32-bit
+//    indices.  Slots are carved from chunks of CHUNK_NODES, and
+//    the address of every chunk is kept in one table shared by all
+//    threads, so an index names the same slot wherever it is used.
+//    A chunk is aligned to its own size and its slot 0 is never
+//    handed out: it holds the chunk number, from which a slot's
+//    index follows from its address, and it makes index 0 free to
+//    mean no node.  A pool reuses released slots, and reset gives
+//    back all of them at once, keeping one chunk for the next use.
+//    Chunks given back are reused by other pools, never freed.
+//
+
+struct node_pool {
+   static constexpr uint32_t NO_NODE = 0;
+   static constexpr uint32_t CHUNK_BITS = 12;
+   static constexpr uint32_t CHUNK_NODES = uint32_t (1) << CHUNK_BITS;
+   static constexpr size_t SLOT_SIZE = 64;
+   static constexpr size_t CHUNK_SIZE = CHUNK_NODES * SLOT_SIZE;
+
+   node_pool();
+   ~node_pool();
+   node_pool (const node_pool&) = delete;
+   node_pool& operator= (const node_pool&) = delete;
+
+   void* allocate();
+   void release (void* slot);
+   void reset();
+   size_t used() const { return live; }
+   // Slots handed out and not released since the last reset.
+
+   static void* slot (uint32_t index) {
+      return chunk_table[index >> CHUNK_BITS]
+           + (index & (CHUNK_NODES - 1)) * SLOT_SIZE;
+   }
+   static uint32_t index (const void* slot);
+
+   private:
+   static char* chunk_table[];
+   vector<uint32_t> chunks;  // chunk numbers owned by this pool
+   uint32_t next;            // index of the next unused slot
+   uint32_t limit;           // end of the current chunk
+   void* free_slots;         // released slots, linked through
+   size_t live;
+};
+
+inline uint32_t node_pool::index (const void* slot) {
+   uintptr_t address = reinterpret_cast<uintptr_t> (slot);
+   uintptr_t base = address & ~(uintptr_t (CHUNK_SIZE) - 1);
+   uint32_t chunk = *reinterpret_cast<const uint32_t*> (base);
+   return chunk << CHUNK_BITS
+        | static_cast<uint32_t> ((address - base) / SLOT_SIZE);
+}
+
+#endif
+
@@ -0,0 +1,481 @@
+// Benchmarks for oc components.
+//
+// Usage: ocbench [-r runs] [-t threads] [-e program.oc] [input.oc]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "astree.h"
+#include "auxlib.h"
+#include "emitter.h"
+#include "lyutils.h"
+#include "string_set.h"
+#include "symbol_table.h"
+#include "visitor.h"
+
+using bench_clock = chrono::steady_clock;
+
+const string cpp_name = "/usr/bin/cpp";
+
+// Each benchmark is run this many times after one warm-up run.
+int samples = 20;
+
+// bench_intern_threads doubles its threads up to this many.
+size_t max_threads = 64;
+
+// Every heap allocation made through operator new, replaced below.
+atomic<size_t> allocations {0};
+
+void* operator new (size_t size) {
+   allocations.fetch_add (1, memory_order_relaxed);
+   void* memory = malloc (size == 0 ? 1 : size);
+   if (memory == nullptr) throw bad_alloc();
+   return memory;
+}
+
+void operator delete (void* memory) noexcept {
+   free (memory);
+}
+
+void operator delete (void* memory, size_t) noexcept {
+   free (memory);
+}
+
+// A small oc program, repeated to make synthetic input.
+const char* sample_program = R"(
+struct node {
+   int value;
+   ptr<struct node> link;
+};
+int count = 0;
+string greeting = "hello, world\n";
+int fib (int n) {
+   if (n < 2) return n;
+   return fib (n - 1) + fib (n - 2);
+}
+void walk (ptr<struct node> head) {
+   while (head != nullptr) {
+      count = count + head->value * 3 - 1;
+      head = head->link;
+   }
+}
+)";
+
+//Writes copies of sample_program to a temporary file.
+string make_input (size_t copies) {
+   char name[] = "/tmp/ocbench.XXXXXX";
+   int fd = mkstemp (name);
+   if (fd < 0) {
+      syserrprintf (name);
+      exit (exec::exit_status);
+   }
+   FILE* file = fdopen (fd, "w");
+   for (size_t i = 0; i < copies; ++i) fputs (sample_program, file);
+   fclose (file);
+   return name;
+}
+
+//Prints how many heap allocations one run of body makes.
+void count_allocations (const char* name,
+                        const function<size_t()>& body) {
+   size_t before = allocations.load();
+   body();
+   printf ("%-14s %9zu heap allocations\n", name,
+           allocations.load() - before);
+   fflush (stdout);
+}
+
+//Runs body once to warm up, then samples times, and prints the
+//median and 95th percentile time of one run.  body returns the
+//number of items it processed, for the throughput column.
+void run_bench (const char* name, const char* unit,
+                const function<size_t()>& body) {
+   body();
+   vector<double> times;
+   size_t items = 0;
+   for (int sample = 0; sample < samples; ++sample) {
+      auto start = bench_clock::now();
+      items = body();
+      chrono::duration<double> elapsed = bench_clock::now() - start;
+      times.push_back (elapsed.count());
+   }
+   sort (times.begin(), times.end());
+   double median = times[times.size() / 2];
+   double p95 = times[min (times.size() - 1, times.size() * 95 / 100)];
+   printf ("%-14s %4zu iters  median %9.3f ms  p95 %9.3f ms"
+           "  %12.0f %s/sec\n", name, times.size(), median * 1e3,
+           p95 * 1e3, items / median, unit);
+   fflush (stdout);
+}
+
+//A vocabulary of distinct identifiers of varied length.
+vector<string> make_words (size_t vocabulary) {
+   mt19937 random (1);
+   vector<string> words;
+   uniform_int_distribution<int> length (1, 12);
+   uniform_int_distribution<int> letter ('a', 'z');
+   for (size_t i = 0; i < vocabulary; ++i) {
+      string word;
+      for (int n = length (random); n > 0; --n) word += letter (random);
+      words.push_back (word + "_" + to_string (i));
+   }
+   return words;
+}
+
+//Identifiers drawn from a Zipf-like distribution, as in real
+//programs, where a few names are used far more than the rest.
+vector<string> make_identifiers (size_t count, size_t vocabulary) {
+   mt19937 random (2);
+   vector<string> words = make_words (vocabulary);
+   vector<double> weights;
+   for (size_t i = 1; i <= vocabulary; ++i) weights.push_back (1.0 / i);
+   discrete_distribution<size_t> zipf (weights.begin(), weights.end());
+   vector<string> identifiers;
+   for (size_t i = 0; i < count; ++i) {
+      identifiers.push_back (words[zipf (random)]);
+   }
+   return identifiers;
+}
+
+void bench_intern() {
+   vector<string> identifiers = make_identifiers (100000, 5000);
+   run_bench ("intern", "strings", [&identifiers] {
+      for (const string& name: identifiers) {
+         string_set::intern (name.data(), name.size());
+      }
+      return identifiers.size();
+   });
+}
+
+//Interns on 1, 2, 4 ... max_threads threads at once, each its own
+//copy of the identifiers, with every tenth one its own, into a set
+//emptied before each run.
+void bench_intern_threads() {
+   vector<string> identifiers = make_identifiers (50000, 5000);
+   for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+      vector<vector<string>> inputs (threads, identifiers);
+      for (size_t t = 0; t < threads; ++t) {
+         for (size_t i = 0; i < identifiers.size(); i += 10) {
+            inputs[t][i] += "_t" + to_string (t);
+         }
+      }
+      char name[32];
+      snprintf (name, sizeof name, "intern %zut", threads);
+      run_bench (name, "strings", [&inputs] {
+         string_set::reset();
+         vector<thread> workers;
+         for (const vector<string>& input: inputs) {
+            workers.emplace_back ([&input] {
+               for (const string& text: input) {
+                  string_set::intern (text.data(), text.size());
+               }
+            });
+         }
+         for (thread& worker: workers) worker.join();
+         return inputs.size() * inputs.front().size();
+      });
+   }
+   string_set::reset();
+}
+
+//Looks up variables declared as globals and in nested blocks.
+//check_var has half the names global and the rest in one block;
+//"check_var N" spreads the rest over N nested blocks, and looks
+//them up with all N open.
+void bench_symbols() {
+   const location lloc {0, 0, 0};
+   vector<const interned*> names;
+   for (const string& name: make_words (2000)) {
+      names.push_back (string_set::intern (name.c_str()));
+   }
+   vector<astree*> uses;
+   for (const string& name: make_identifiers (100000, 2000)) {
+      uses.push_back (new astree (TOK_IDENT, lloc, name.c_str()));
+   }
+   run_bench ("table_insert", "symbols", [&names, &lloc] {
+      symbol_table table;
+      for (const interned* name: names) {
+         table_insert (name, new symbol_node (lloc, 0), &table);
+      }
+      for (const symbol_table::binding& entry: table) {
+         delete entry.node;
+      }
+      return names.size();
+   });
+   for (size_t blocks: {1, 32}) {
+      symbol_generator generator;
+      size_t globals = names.size() / 2;
+      for (size_t i = 0; i < names.size(); ++i) {
+         if (i >= globals and (i - globals) % (globals / blocks) == 0
+          and generator.names.depth() < blocks) {
+            generator.names.enter();
+         }
+         table_insert (names[i], new symbol_node (lloc, 0),
+                       &generator.names);
+      }
+      string name = blocks == 1 ? "check_var"
+                  : "check_var " + to_string (blocks);
+      run_bench (name.c_str(), "lookups", [&generator, &uses] {
+         for (astree* use: uses) generator.check_var (use);
+         return uses.size();
+      });
+   }
+   for (astree* use: uses) delete use;
+}
+
+//Counts tokens until end of file, discarding them.
+size_t drain (lexer& lex) {
+   size_t tokens = 0;
+   YYSTYPE yylval = nullptr;
+   while (yylex (&yylval, lex.scanner) != 0) {
+      ++tokens;
+      delete yylval;
+      yylval = nullptr;
+   }
+   return tokens;
+}
+
+size_t scan_pipe (const string& filename) {
+   string command = cpp_name + " " + filename;
+   FILE* pipe = popen (command.c_str(), "r");
+   if (pipe == nullptr) {
+      syserrprintf (command.c_str());
+      exit (exec::exit_status);
+   }
+   lexer lex;
+   lex.newfilename (command);
+   lex.open (pipe);
+   size_t tokens = drain (lex);
+   lex.close();
+   pclose (pipe);
+   return tokens;
+}
+
+size_t scan_mapped (const string& filename) {
+   lexer lex;
+   lex.newfilename (filename);
+   if (not lex.open_mapped (filename)) {
+      syserrprintf (filename.c_str());
+      exit (exec::exit_status);
+   }
+   size_t tokens = drain (lex);
+   lex.close();
+   return tokens;
+}
+
+//Compares tokens/sec through the cpp pipe and through mmap.
+void bench_scan (const string& filename) {
+   run_bench ("yylex pipe", "tokens", [&filename] {
+      return scan_pipe (filename);
+   });
+   run_bench ("yylex mmap", "tokens", [&filename] {
+      return scan_mapped (filename);
+   });
+}
+
+//Counts the nodes with the walk the passes use, so that a deep
+//tree does not overflow the stack.
+size_t count_nodes (astree* tree) {
+   size_t nodes = 0;
+   astree::walk (tree, [&nodes] (astree*, int) {
+      ++nodes;
+      return true;
+   }, [] (astree*) {});
+   return nodes;
+}
+
+//Parses the mapped file and returns its syntax tree.
+astree* parse_mapped (const string& filename) {
+   lexer lex;
+   parser state (lex);
+   lexer::current = &lex;
+   lex.newfilename (filename);
+   if (not lex.open_mapped (filename)) {
+      syserrprintf (filename.c_str());
+      exit (exec::exit_status);
+   }
+   state.parse();
+   lex.close();
+   lexer::current = nullptr;
+   return state.root;
+}
+
+void bench_parse (const string& filename) {
+   run_bench ("yyparse", "nodes", [&filename] {
+      astree* root = parse_mapped (filename);
+      size_t nodes = count_nodes (root);
+      delete root;
+      return nodes;
+   });
+}
+
+//Times a preorder walk of the parsed file, which is what the
+//symbol table and emitter passes do, after printing the node size.
+void bench_walk (const string& filename) {
+   printf ("%-14s %4zu bytes\n", "astree size", sizeof (astree));
+   astree* root = parse_mapped (filename);
+   run_bench ("astree walk", "nodes", [root] {
+      return count_nodes (root);
+   });
+   delete root;
+}
+
+//Builds the symbol tables and type checks the parsed file, with
+//the .sym output and any messages thrown away, alone and then
+//with the .ast dump, as two walks and as one fused walk.
+void bench_traverse (const string& filename) {
+   FILE* null_file = fopen ("/dev/null", "w");
+   if (null_file == nullptr) {
+      syserrprintf ("/dev/null");
+      return;
+   }
+   astree* root = parse_mapped (filename);
+   size_t nodes = count_nodes (root);
+   string discard;
+   exec::captured_out = &discard;
+   exec::captured_err = &discard;
+   auto traverse = [root, null_file, nodes, &discard] {
+      symbol_generator generator (null_file);
+      generator.traverse (root);
+      discard.clear();
+      return nodes;
+   };
+   run_bench ("traverse", "nodes", traverse);
+   count_allocations ("traverse", traverse);
+   run_bench ("sym, ast", "nodes", [root, null_file, nodes, &discard] {
+      symbol_generator generator (null_file);
+      generator.traverse (root);
+      astree::print (null_file, root);
+      discard.clear();
+      return nodes;
+   });
+   run_bench ("sym+ast fused", "nodes",
+              [root, null_file, nodes, &discard] {
+      symbol_generator generator (null_file);
+      table_builder builder (generator);
+      ast_printer printer (null_file);
+      visit (root, builder, printer);
+      discard.clear();
+      return nodes;
+   });
+   exec::captured_out = nullptr;
+   exec::captured_err = nullptr;
+   exec::exit_status = EXIT_SUCCESS;
+   delete root;
+   fclose (null_file);
+}
+
+//Builds statement lists of binary expressions, then frees them,
+//either deleting each node or by resetting a node_pool.
+void bench_astree() {
+   const location lloc {0, 0, 0};
+   const size_t statements = 20000;
+   auto build = [&lloc, statements] {
+      astree* root = new astree (TOK_ROOT, lloc, "");
+      for (size_t i = 0; i < statements; ++i) {
+         astree* plus = new astree ('+', lloc, "+");
+         plus->adopt (new astree (TOK_IDENT, lloc, "count"),
+                      new astree (TOK_INTCON, lloc, "1"));
+         astree* assign = new astree ('=', lloc, "=");
+         root->adopt (assign->adopt (
+                      new astree (TOK_IDENT, lloc, "count"), plus));
+      }
+      return root;
+   };
+   run_bench ("astree", "nodes", [&build, statements] {
+      delete build();
+      return statements * 5 + 1;
+   });
+   node_pool nodes;
+   run_bench ("astree pool", "nodes", [&build, &nodes, statements] {
+      astree::pool = &nodes;
+      build();
+      nodes.reset();
+      astree::pool = nullptr;
+      return statements * 5 + 1;
+   });
+}
+
+void bench_emit_insn() {
+   const size_t count = 200000;
+   FILE* null_file = fopen ("/dev/null", "w");
+   if (null_file == nullptr) {
+      syserrprintf ("/dev/null");
+      return;
+   }
+   oil_writer out (null_file);
+   emitter code (out);
+   run_bench ("emit_insn", "insns", [&code, count] {
+      for (size_t i = 0; i < count; ++i) {
+         code.emit_insn ("i$3:i = i$1:i + i$2:i", "");
+      }
+      return count;
+   });
+   out.flush();
+   fclose (null_file);
+}
+
+//Emits a whole program, which must be one the emitter can handle,
+//such as the output of ocgen.
+void bench_emit (const string& filename) {
+   FILE* null_file = fopen ("/dev/null", "w");
+   if (null_file == nullptr) {
+      syserrprintf ("/dev/null");
+      return;
+   }
+   astree* root = parse_mapped (filename);
+   size_t nodes = count_nodes (root);
+   run_bench ("emit", "nodes", [root, null_file, nodes] {
+      oil_writer out (null_file);
+      emitter code (out);
+      code.emit_program (root);
+      return nodes;
+   });
+   delete root;
+   fclose (null_file);
+}
+
+int main (int argc, char** argv) {
+   exec::execname = basename (argv[0]);
+   lexer::interactive = true;
+   string emit_input;
+   for(;;) {
+      int opt = getopt (argc, argv, "e:r:t:");
+      if (opt == EOF) break;
+      switch (opt) {
+         case 'e': emit_input = optarg;              break;
+         case 'r': samples = max (1, atoi (optarg)); break;
+         case 't': max_threads = max (0, atoi (optarg)); break;
+         default:  errprintf ("bad option (%c)\n", optopt); break;
+      }
+   }
+   bool temporary = optind == argc;
+   string input = temporary ? make_input (2000) : argv[optind];
+   bench_intern();
+   bench_intern_threads();
+   bench_symbols();
+   bench_scan (input);
+   bench_parse (input);
+   bench_walk (input);
+   bench_traverse (input);
+   bench_astree();
+   bench_emit_insn();
+   if (not emit_input.empty()) bench_emit (emit_input);
+   if (temporary) unlink (input.c_str());
+   return exec::exit_status;
+}
+
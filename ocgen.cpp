@@ -0,0 +1,281 @@
+// Generates synthetic oc programs for benchmarking.
+//
+// The output uses only the grammar in parser.y.  Its shape is set
+// by the options:
+//    -l lines   stop after about this many lines (default 1000)
+//    -s count   number of struct definitions (default 16)
+//    -p count   most parameters per function (default 4)
+//    -n depth   most nesting of while and if (default 3)
+//    -x depth   most nesting of expressions (default 4)
+//    -i bits    identifier entropy: names are drawn from a
+//               vocabulary of 2^bits words (default 10)
+//    -t percent string literal density: share of constants and
+//               declarations that are strings (default 10)
+//    -u percent share of inner expression nodes that are unary
+//               operators or calls (default 0, since the emitter
+//               does not handle them inside expressions yet)
+//    -r seed    random seed (default 1)
+//    -c terms   write only a function whose one statement is a
+//               chain of this many terms, as a deep tree for
+//               testing, instead of a program
+
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "auxlib.h"
+
+struct options {
+   size_t lines = 1000;
+   int structs = 16;
+   int params = 4;
+   int nesting = 3;
+   int expr_depth = 4;
+   int entropy = 10;
+   int strings = 10;
+   int unary = 0;
+   unsigned seed = 1;
+   size_t chain = 0;
+};
+
+struct generator {
+   options opts;
+   mt19937 random;
+   vector<string> vocabulary;
+   size_t lines = 0;
+   int locals = 0;           // locals declared in this function
+   vector<string> ints;      // int variables in scope
+   vector<string> functions; // int functions of one int parameter
+
+   generator (const options& opts_);
+   int pick (int low, int high) {
+      return uniform_int_distribution<int> (low, high) (random);
+   }
+   bool percent (int chance) { return pick (0, 99) < chance; }
+   const string& word() {
+      return vocabulary[pick (0, vocabulary.size() - 1)];
+   }
+   void line (int depth, const string& text);
+   string string_literal();
+   string expr (int depth);
+   void statement (int depth, int nesting);
+   void structdef (int number);
+   void function (int number);
+   void program();
+   void chain();
+};
+
+generator::generator (const options& opts_):
+           opts (opts_), random (opts_.seed) {
+   size_t size = size_t (1) << opts.entropy;
+   for (size_t i = 0; i < size; ++i) {
+      string name;
+      for (int n = pick (1, 8); n > 0; --n) {
+         name += char ('a' + pick (0, 25));
+      }
+      vocabulary.push_back (name);
+   }
+}
+
+void generator::line (int depth, const string& text) {
+   printf ("%*s%s\n", depth * 3, "", text.c_str());
+   ++lines;
+}
+
+string generator::string_literal() {
+   static const char* escapes[] {"\\n", "\\t", "\\\\", "\\\""};
+   string text = "\"" + word();
+   if (percent (30)) text += escapes[pick (0, 3)];
+   return text + " " + word() + "\"";
+}
+
+//An int-valued expression of at most depth levels.
+string generator::expr (int depth) {
+   if (depth <= 0 or percent (25)) {
+      if (ints.empty() or percent (40)) {
+         return to_string (pick (0, 1000));
+      }
+      return ints[pick (0, ints.size() - 1)];
+   }
+   if (percent (opts.unary)) {
+      if (functions.empty() or percent (50)) {
+         return "-" + expr (depth - 1);
+      }
+      return functions[pick (0, functions.size() - 1)]
+           + " (" + expr (depth - 1) + ")";
+   }
+   if (percent (10)) return "(" + expr (depth - 1) + ")";
+   static const char* ops[] {"+", "-", "*", "/", "%"};
+   return expr (depth - 1) + " " + ops[pick (0, 4)] + " "
+        + expr (depth - 1);
+}
+
+void generator::statement (int depth, int nesting) {
+   static const char* compares[] {"<", "<=", ">", ">=", "=="};
+   int choice = nesting <= 0 ? pick (0, 2) : pick (0, 5);
+   string condition = expr (1) + " " + compares[pick (0, 4)] + " "
+                    + expr (1);
+   switch (choice) {
+      case 0:
+         if (not ints.empty()) {
+            line (depth, ints[pick (0, ints.size() - 1)] + " = "
+                         + expr (opts.expr_depth) + ";");
+            break;
+         }
+         [[fallthrough]];
+      case 1: {
+         string name = word() + "_" + to_string (locals++);
+         if (percent (opts.strings)) {
+            line (depth, "string " + name + " = "
+                         + string_literal() + ";");
+         }else {
+            line (depth, "int " + name + " = "
+                         + expr (opts.expr_depth) + ";");
+            ints.push_back (name);
+         }
+         break;
+      }
+      case 2:
+         if (functions.empty()) {
+            line (depth, expr (opts.expr_depth) + ";");
+         }else {
+            line (depth, functions[pick (0, functions.size() - 1)]
+                         + " (" + expr (opts.expr_depth) + ");");
+         }
+         break;
+      case 3: {
+         line (depth, "while (" + condition + ") {");
+         size_t scope = ints.size();
+         for (int n = pick (1, 3); n > 0; --n) {
+            statement (depth + 1, nesting - 1);
+         }
+         ints.resize (scope);
+         line (depth, "}");
+         break;
+      }
+      default: {
+         line (depth, "if (" + condition + ") {");
+         size_t scope = ints.size();
+         for (int n = pick (1, 3); n > 0; --n) {
+            statement (depth + 1, nesting - 1);
+         }
+         ints.resize (scope);
+         if (percent (50)) {
+            line (depth, "}");
+         }else {
+            line (depth, "} else {");
+            for (int n = pick (1, 2); n > 0; --n) {
+               statement (depth + 1, nesting - 1);
+            }
+            ints.resize (scope);
+            line (depth, "}");
+         }
+         break;
+      }
+   }
+}
+
+void generator::structdef (int number) {
+   string name = "s" + to_string (number);
+   line (0, "struct " + name + " {");
+   line (1, "int " + word() + "_0;");
+   line (1, "string " + word() + "_1;");
+   line (1, "array<int> " + word() + "_2;");
+   line (1, "ptr<struct " + name + "> " + word() + "_3;");
+   line (0, "};");
+}
+
+void generator::function (int number) {
+   string name = word() + "_f" + to_string (number);
+   string header = "int " + name + " (";
+   ints.clear();
+   locals = 0;
+   int params = pick (1, opts.params);
+   for (int param = 0; param < params; ++param) {
+      string param_name = word() + "_p" + to_string (param);
+      if (param > 0) header += ", ";
+      header += "int " + param_name;
+      ints.push_back (param_name);
+   }
+   bool node_param = opts.structs > 0 and percent (25);
+   if (node_param) {
+      int type = pick (0, opts.structs - 1);
+      header += ", ptr<struct s" + to_string (type) + "> "
+              + word() + "_node";
+   }
+   line (0, header + ") {");
+   for (int n = pick (2, 8); n > 0; --n) {
+      statement (1, pick (0, opts.nesting));
+   }
+   line (1, "return " + expr (opts.expr_depth) + ";");
+   line (0, "}");
+   if (params == 1 and not node_param) functions.push_back (name);
+}
+
+void generator::program() {
+   for (int number = 0; number < opts.structs; ++number) {
+      structdef (number);
+   }
+   line (0, "int " + word() + "_global = " + to_string (pick (0, 9))
+            + ";");
+   line (0, "string " + word() + "_greeting = " + string_literal()
+            + ";");
+   for (int number = 0; lines < opts.lines; ++number) {
+      function (number);
+   }
+}
+
+//The terms are added and subtracted left to right, so the tree
+//of the expression is as deep as the chain is long.
+void generator::chain() {
+   line (0, "int chain (int x) {");
+   string text = "x = x";
+   for (size_t term = 1; term < opts.chain; ++term) {
+      text += term % 2 ? " + " : " - ";
+      text += to_string (term % 100);
+      if (term % 12 == 0) {
+         line (1, text);
+         text.clear();
+      }
+   }
+   line (1, text + ";");
+   line (1, "return x;");
+   line (0, "}");
+}
+
+int main (int argc, char** argv) {
+   exec::execname = basename (argv[0]);
+   options opts;
+   for(;;) {
+      int opt = getopt (argc, argv, "c:i:l:n:p:r:s:t:u:x:");
+      if (opt == EOF) break;
+      switch (opt) {
+         case 'c': opts.chain = strtoull (optarg, nullptr, 10); break;
+         case 'i': opts.entropy = atoi (optarg);     break;
+         case 'l': opts.lines = strtoull (optarg, nullptr, 10); break;
+         case 'n': opts.nesting = atoi (optarg);     break;
+         case 'p': opts.params = atoi (optarg);      break;
+         case 'r': opts.seed = atoi (optarg);        break;
+         case 's': opts.structs = atoi (optarg);     break;
+         case 't': opts.strings = atoi (optarg);     break;
+         case 'u': opts.unary = atoi (optarg);       break;
+         case 'x': opts.expr_depth = atoi (optarg);  break;
+         default:  errprintf ("bad option (%c)\n", optopt); break;
+      }
+   }
+   if (opts.entropy < 1 or opts.entropy > 24 or opts.params < 1) {
+      errprintf ("%:-i must be 1 to 24 and -p at least 1\n");
+      return exec::exit_status;
+   }
+   generator gen (opts);
+   if (opts.chain > 0) gen.chain();
+                  else gen.program();
+   return exec::exit_status;
+}
+
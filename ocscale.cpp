@@ -0,0 +1,251 @@
+// Scaling benchmark: compiles ocgen corpora of increasing size and
+// compares throughput with a baseline.
+//
+// Usage: ocscale [-b baseline] [-c oc] [-m maxlines] [-r runs]
+//                [-t percent] [-u] [-- oc options]
+//    -b file    baseline to compare with (default scaling.baseline)
+//    -c path    the oc to measure (default ./oc)
+//    -m lines   largest corpus, a power of ten (default 1000000)
+//    -r runs    compilations per size; the median is kept (default
+//               the count the baseline was recorded with, or 5)
+//    -t percent fail if lines/sec falls more than this far, plus the
+//               spread recorded for the size, below the baseline
+//               (default 15)
+//    -u         write the results to the baseline instead
+// Options after -- are passed to oc.  Every size measured must have
+// a row in the baseline, or the comparison fails.
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "auxlib.h"
+
+using bench_clock = chrono::steady_clock;
+
+const char* oc_path = "./oc";
+const char* ocgen_path = "./ocgen";
+
+struct measurement {
+   size_t size;              // lines asked of ocgen
+   double lines_per_sec;
+   long peak_kib;
+   double spread;            // range of the runs, % of the median
+};
+
+//Runs argv with stdout sent to outname, and returns its wait
+//status, with its resource usage in usage.
+int run (vector<string> args, const char* outname, rusage& usage) {
+   vector<char*> argv;
+   for (string& arg: args) argv.push_back (&arg[0]);
+   argv.push_back (nullptr);
+   fflush (nullptr);
+   pid_t pid = fork();
+   if (pid < 0) {
+      syserrprintf ("fork");
+      return -1;
+   }
+   if (pid == 0) {
+      int out = open (outname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      int null = open ("/dev/null", O_WRONLY);
+      if (out < 0 or null < 0) _exit (127);
+      dup2 (out, STDOUT_FILENO);
+      dup2 (null, STDERR_FILENO);
+      execv (argv[0], argv.data());
+      _exit (127);
+   }
+   int status;
+   while (wait4 (pid, &status, 0, &usage) < 0) {
+      if (errno != EINTR) {
+         syserrprintf ("wait4");
+         return -1;
+      }
+   }
+   return status;
+}
+
+size_t count_lines (const string& filename) {
+   ifstream file (filename);
+   return count (istreambuf_iterator<char> (file),
+                 istreambuf_iterator<char>(), '\n');
+}
+
+//Reads the rows of the baseline, and into runs the number of
+//compilations per size it was recorded with, if it says.
+map<size_t, measurement> read_baseline (const string& filename,
+                                        int& runs) {
+   map<size_t, measurement> baseline;
+   ifstream file (filename);
+   string line;
+   while (getline (file, line)) {
+      if (line.empty() or line[0] == '#') continue;
+      if (line.compare (0, 5, "runs ") == 0) {
+         runs = max (1, atoi (line.c_str() + 5));
+         continue;
+      }
+      istringstream fields (line);
+      measurement entry;
+      if (fields >> entry.size >> entry.lines_per_sec
+                 >> entry.peak_kib) {
+         if (not (fields >> entry.spread)) entry.spread = 0;
+         baseline[entry.size] = entry;
+      }
+   }
+   return baseline;
+}
+
+void write_baseline (const string& filename,
+                     const vector<measurement>& results,
+                     int runs, const vector<string>& oc_options) {
+   FILE* file = fopen (filename.c_str(), "w");
+   if (file == nullptr) {
+      syserrprintf (filename.c_str());
+      return;
+   }
+   fprintf (file, "# Written by ocscale -u.  oc options:");
+   for (const string& option: oc_options) {
+      fprintf (file, " %s", option.c_str());
+   }
+   fprintf (file, "\nruns %d\n", runs);
+   fprintf (file, "# size  lines/sec  peak KiB  spread %%\n");
+   for (const measurement& entry: results) {
+      fprintf (file, "%zu %.0f %ld %.1f\n", entry.size,
+               entry.lines_per_sec, entry.peak_kib, entry.spread);
+   }
+   fclose (file);
+}
+
+//Generates a corpus of about size lines and compiles it runs
+//times.  Returns false if either step failed.
+bool measure (size_t size, int runs, const vector<string>& oc_options,
+              measurement& result) {
+   char dirname[] = "/tmp/ocscale.XXXXXX";
+   if (mkdtemp (dirname) == nullptr) {
+      syserrprintf ("mkdtemp");
+      return false;
+   }
+   string source = string (dirname) + "/corpus.oc";
+   rusage usage;
+   int status = run ({ocgen_path, "-l", to_string (size)},
+                     source.c_str(), usage);
+   bool ok = status == 0;
+   if (not ok) errprintf ("%:%s failed\n", ocgen_path);
+   size_t lines = count_lines (source);
+   result.size = size;
+   result.peak_kib = 0;
+   vector<double> times;
+   for (int count = 0; ok and count < runs; ++count) {
+      vector<string> args {oc_path};
+      args.insert (args.end(), oc_options.begin(), oc_options.end());
+      args.push_back (source);
+      auto start = bench_clock::now();
+      status = run (args, "/dev/null", usage);
+      chrono::duration<double> elapsed = bench_clock::now() - start;
+      if (status != 0) {
+         errprintf ("%:%s %s failed\n", oc_path, source.c_str());
+         ok = false;
+      }
+      times.push_back (elapsed.count());
+      result.peak_kib = max (result.peak_kib, usage.ru_maxrss);
+   }
+   if (ok) {
+      sort (times.begin(), times.end());
+      double median = times[times.size() / 2];
+      result.lines_per_sec = lines / median;
+      result.spread = 100 * (times.back() - times.front()) / median;
+   }
+   string command = "rm -rf " + string (dirname);
+   if (system (command.c_str()) != 0) {
+      errprintf ("%:%s failed\n", command.c_str());
+   }
+   return ok;
+}
+
+int main (int argc, char** argv) {
+   exec::execname = basename (argv[0]);
+   string baseline_file = "scaling.baseline";
+   size_t max_lines = 1000000;
+   int runs = 0;
+   double threshold = 15;
+   bool update = false;
+   for(;;) {
+      int opt = getopt (argc, argv, "b:c:m:r:t:u");
+      if (opt == EOF) break;
+      switch (opt) {
+         case 'b': baseline_file = optarg;                     break;
+         case 'c': oc_path = optarg;                           break;
+         case 'm': max_lines = strtoull (optarg, nullptr, 10); break;
+         case 'r': runs = max (1, atoi (optarg));              break;
+         case 't': threshold = atof (optarg);                  break;
+         case 'u': update = true;                              break;
+         default:  errprintf ("bad option (%c)\n", optopt);    break;
+      }
+   }
+   if (exec::exit_status != EXIT_SUCCESS) return exec::exit_status;
+   vector<string> oc_options (&argv[optind], &argv[argc]);
+   map<size_t, measurement> baseline;
+   if (not update) {
+      int recorded = 0;
+      baseline = read_baseline (baseline_file, recorded);
+      if (baseline.empty()) {
+         errprintf ("%:%s: no baseline rows; run make "
+                    "scale-baseline\n", baseline_file.c_str());
+         return exec::exit_status;
+      }
+      // Compare medians of as many runs as the baseline's.
+      if (runs == 0) runs = recorded;
+   }
+   if (runs == 0) runs = 5;
+   vector<measurement> results;
+   bool regressed = false;
+   printf ("%10s %14s %10s %14s %8s %8s\n", "size", "lines/sec",
+           "peak MiB", "baseline", "change", "allowed");
+   for (size_t size = 1000; size <= max_lines; size *= 10) {
+      measurement result;
+      if (not measure (size, runs, oc_options, result)) break;
+      results.push_back (result);
+      printf ("%10zu %14.0f %10.1f", size, result.lines_per_sec,
+              result.peak_kib / 1024.0);
+      auto found = baseline.find (size);
+      if (update) {
+         printf ("\n");
+      }else if (found == baseline.end()) {
+         printf (" %14s\n", "-");
+         errprintf ("%:%s: no row for size %zu\n",
+                    baseline_file.c_str(), size);
+      }else {
+         double expected = found->second.lines_per_sec;
+         double change = 100 * (result.lines_per_sec / expected - 1);
+         double allowed = threshold + found->second.spread;
+         bool slow = change < -allowed;
+         printf (" %14.0f %+7.1f%% %7.1f%%%s\n", expected, change,
+                 -allowed, slow ? "  REGRESSION" : "");
+         regressed = regressed or slow;
+      }
+      fflush (stdout);
+   }
+   if (update) {
+      write_baseline (baseline_file, results, runs, oc_options);
+   }
+   if (regressed) {
+      errprintf ("%:throughput regressed more than %.0f%% plus the"
+                 " recorded spread\n", threshold);
+   }
+   return exec::exit_status;
+}
+
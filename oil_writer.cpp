@@ -0,0 +1,86 @@
+#include <string>
+#include <string_view>
+using namespace std;
+
+#include <stdio.h>
+
+#include "oil_writer.h"
+
+//Converts the digits from the right, into a local array, since
+//to_string would allocate.
+static void append_number (string& out, long value) {
+   char digits[24];
+   char* digit = &digits[sizeof digits];
+   bool negative = value < 0;
+   unsigned long magnitude = value;
+   if (negative) magnitude = -magnitude;
+   do {
+      *--digit = '0' + magnitude % 10;
+      magnitude /= 10;
+   }while (magnitude != 0);
+   if (negative) *--digit = '-';
+   out.append (digit, &digits[sizeof digits] - digit);
+}
+
+oil_writer::oil_writer (FILE* file_): file (file_) {
+   if (file != nullptr) buffer.reserve (2 * FLUSH_SIZE);
+}
+
+oil_writer::~oil_writer() {
+   flush();
+}
+
+void oil_writer::label (string_view name) {
+   pending.assign (name.data(), name.size());
+   pending += ':';
+}
+
+void oil_writer::label (const char* prefix, int index) {
+   pending = prefix;
+   append_number (pending, index);
+   pending += ':';
+}
+
+void oil_writer::clear_label() {
+   pending.clear();
+}
+
+oil_writer& oil_writer::start() {
+   buffer += pending;
+   if (pending.size() < 10) buffer.append (10 - pending.size(), ' ');
+   pending.clear();
+   return *this;
+}
+
+oil_writer& oil_writer::text (string_view chars) {
+   buffer.append (chars.data(), chars.size());
+   return *this;
+}
+
+oil_writer& oil_writer::number (long value) {
+   append_number (buffer, value);
+   return *this;
+}
+
+oil_writer& oil_writer::temp (int index) {
+   text ("$t");
+   append_number (buffer, index);
+   return text (":i");
+}
+
+void oil_writer::end() {
+   buffer += '\n';
+   if (buffer.size() >= FLUSH_SIZE) flush();
+}
+
+void oil_writer::append (const oil_writer& other) {
+   buffer += other.buffer;
+   if (buffer.size() >= FLUSH_SIZE) flush();
+}
+
+void oil_writer::flush() {
+   if (file == nullptr or buffer.empty()) return;
+   fwrite (buffer.data(), 1, buffer.size(), file);
+   buffer.clear();
+}
+
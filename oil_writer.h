@@ -0,0 +1,58 @@
+#ifndef __OIL_WRITER_H__
+#define __OIL_WRITER_H__
+
+#include <string>
+#include <string_view>
+using namespace std;
+
+#include <stdio.h>
+
+//
+// DESCRIPTION
+//    Formats .oil instructions into an append-only buffer, which is
+//    written to the output file each time it fills.  An instruction
+//    is started, built from typed pieces, and ended, so that once
+//    the buffer has grown to size writing one allocates nothing.  A
+//    writer with no file keeps all it is given, to be appended to
+//    another writer later.
+//
+
+struct oil_writer {
+   static constexpr size_t FLUSH_SIZE = size_t (1) << 16;
+
+   oil_writer (FILE* file);
+   ~oil_writer();
+   oil_writer (const oil_writer&) = delete;
+   oil_writer& operator= (const oil_writer&) = delete;
+
+   void label (string_view name);
+   void label (const char* prefix, int index);
+   // Sets the label of the next instruction, to name: or to
+   // prefixindex:, replacing any label not yet written.
+
+   void clear_label();
+
+   oil_writer& start();
+   // Starts an instruction with its label, padded to 10 columns.
+
+   oil_writer& text (string_view chars);
+   oil_writer& number (long value);
+   oil_writer& temp (int index);
+   // Appends $tindex:i, a temporary register.
+
+   void end();
+   // Ends the instruction, flushing the buffer if it is full.
+
+   void append (const oil_writer& other);
+   // Appends everything other has buffered.
+
+   void flush();
+
+   private:
+   FILE* file;
+   string buffer;
+   string pending;           // label of the next instruction
+};
+
+#endif
+
@@ -15,11 +15,14 @@
 %token-table
 %verbose
 
+%define api.pure full
+%param { parser& state }
+
 %destructor { destroy ($$); } <>
 %printer { astree::dump (yyoutput, $$); } <>
 
 %initial-action {
-   parser::root = new astree (TOK_ROOT, {0, 0, 0}, "");
+   state.root = new astree (TOK_ROOT, {0, 0, 0}, "");
 }
 
 %token TOK_VOID TOK_INT TOK_STRING
@@ -50,10 +53,10 @@
 start   : program       { $$ = $1 = nullptr; }
         ;
 
-program : program structdef { $$ = $1->adopt($2); }
-        | program function  { $$ = $1->adopt($2); }
-        | program statement { $$ = $1->adopt($2); }  
-        |                   { $$ = parser::root;  }
+program : program structdef { $$ = state.top_level($1, $2); }
+        | program function  { $$ = state.top_level($1, $2); }
+        | program statement { $$ = state.top_level($1, $2); }
+        |                   { $$ = state.root;    }
         | program error '}' 
           {
             destroy($3); 
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "auxlib.h"
+#include "phase_timer.h"
+
+bool phase_timer::report = false;
+bool phase_timer::counters = false;
+string phase_timer::trace_file;
+vector<phase_timer::record> phase_timer::records;
+mutex phase_timer::lock;
+
+static int64_t clock_micros (clockid_t clock) {
+   timespec now;
+   clock_gettime (clock, &now);
+   return int64_t (now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+// Trace timestamps are relative to the first phase recorded.
+static int64_t epoch = -1;
+
+static const struct {
+   const char* name;
+   uint64_t config;
+} counter_events[phase_timer::NCOUNTERS] {
+   {"instructions",  PERF_COUNT_HW_INSTRUCTIONS },
+   {"cache-misses",  PERF_COUNT_HW_CACHE_MISSES },
+   {"branch-misses", PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+//Opens a counter for the calling thread, or returns -1 if the
+//kernel or the hardware will not provide it.
+static int open_counter (uint64_t config) {
+   perf_event_attr attr;
+   memset (&attr, 0, sizeof attr);
+   attr.type = PERF_TYPE_HARDWARE;
+   attr.size = sizeof attr;
+   attr.config = config;
+   attr.disabled = 1;
+   attr.exclude_kernel = 1;
+   attr.exclude_hv = 1;
+   int fd = syscall (SYS_perf_event_open, &attr, 0, -1, -1, 0);
+   if (fd < 0) return -1;
+   ioctl (fd, PERF_EVENT_IOC_RESET, 0);
+   ioctl (fd, PERF_EVENT_IOC_ENABLE, 0);
+   return fd;
+}
+
+phase_timer::phase_timer (const char* phase, const string& filename):
+             active (enabled()) {
+   if (not active) return;
+   current.phase = phase;
+   current.filename = filename;
+   current.tid = syscall (SYS_gettid);
+   for (int& fd: fds) fd = -1;
+   if (counters) {
+      for (int i = 0; i < NCOUNTERS; ++i) {
+         fds[i] = open_counter (counter_events[i].config);
+      }
+   }
+   start_cpu = clock_micros (CLOCK_THREAD_CPUTIME_ID);
+   start_wall = clock_micros (CLOCK_MONOTONIC);
+}
+
+phase_timer::~phase_timer() {
+   if (not active) return;
+   int64_t end_wall = clock_micros (CLOCK_MONOTONIC);
+   current.cpu = clock_micros (CLOCK_THREAD_CPUTIME_ID) - start_cpu;
+   current.wall = end_wall - start_wall;
+   for (int i = 0; i < NCOUNTERS; ++i) {
+      current.counts[i] = -1;
+      if (fds[i] < 0) continue;
+      ioctl (fds[i], PERF_EVENT_IOC_DISABLE, 0);
+      uint64_t count;
+      if (read (fds[i], &count, sizeof count) == sizeof count) {
+         current.counts[i] = count;
+      }
+      close (fds[i]);
+   }
+   rusage usage;
+   getrusage (RUSAGE_SELF, &usage);
+   current.max_rss = usage.ru_maxrss;
+   lock_guard<mutex> guard (lock);
+   if (epoch < 0 or start_wall < epoch) epoch = start_wall;
+   current.start = start_wall;
+   records.push_back (move (current));
+}
+
+void phase_timer::reset() {
+   lock_guard<mutex> guard (lock);
+   report = false;
+   counters = false;
+   trace_file.clear();
+   records.clear();
+   epoch = -1;
+}
+
+void phase_timer::print_report (FILE* outfile) {
+   struct total {
+      const char* phase;
+      size_t calls;
+      int64_t wall;
+      int64_t cpu;
+      long max_rss;
+      int64_t counts[NCOUNTERS];
+   };
+   vector<total> totals;
+   lock_guard<mutex> guard (lock);
+   for (const record& rec: records) {
+      auto found = find_if (totals.begin(), totals.end(),
+                   [&rec] (const total& sum) {
+                      return strcmp (sum.phase, rec.phase) == 0;
+                   });
+      if (found == totals.end()) {
+         totals.push_back ({rec.phase, 0, 0, 0, 0, {0, 0, 0}});
+         found = totals.end() - 1;
+      }
+      ++found->calls;
+      found->wall += rec.wall;
+      found->cpu += rec.cpu;
+      found->max_rss = max (found->max_rss, rec.max_rss);
+      for (int i = 0; i < NCOUNTERS; ++i) {
+         if (found->counts[i] < 0 or rec.counts[i] < 0) {
+            found->counts[i] = -1;
+         }else {
+            found->counts[i] += rec.counts[i];
+         }
+      }
+   }
+   fprintf (outfile, "%-10s %6s %10s %10s %12s", "phase", "calls",
+            "wall s", "cpu s", "peak RSS KiB");
+   if (counters) {
+      for (const auto& event: counter_events) {
+         fprintf (outfile, " %14s", event.name);
+      }
+   }
+   fprintf (outfile, "\n");
+   for (const total& sum: totals) {
+      fprintf (outfile, "%-10s %6zu %10.6f %10.6f %12ld", sum.phase,
+               sum.calls, sum.wall / 1e6, sum.cpu / 1e6, sum.max_rss);
+      if (counters) {
+         for (int64_t count: sum.counts) {
+            if (count < 0) fprintf (outfile, " %14s", "n/a");
+                      else fprintf (outfile, " %14lld",
+                                    static_cast<long long> (count));
+         }
+      }
+      fprintf (outfile, "\n");
+   }
+}
+
+static void print_json_string (FILE* outfile, const string& text) {
+   fputc ('"', outfile);
+   for (unsigned char chr: text) {
+      if (chr == '"' or chr == '\\') fprintf (outfile, "\\%c", chr);
+      else if (chr < ' ') fprintf (outfile, "\\u%04x", chr);
+      else fputc (chr, outfile);
+   }
+   fputc ('"', outfile);
+}
+
+bool phase_timer::write_trace() {
+   FILE* outfile = fopen (trace_file.c_str(), "w");
+   if (outfile == nullptr) {
+      syserrprintf (trace_file.c_str());
+      return false;
+   }
+   lock_guard<mutex> guard (lock);
+   fprintf (outfile, "{\"traceEvents\":[\n");
+   const char* separator = "";
+   for (const record& rec: records) {
+      fprintf (outfile, "%s{\"name\":\"%s\",\"cat\":\"oc\","
+               "\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,"
+               "\"pid\":%d,\"tid\":%ld,\"args\":{\"file\":",
+               separator, rec.phase,
+               static_cast<long long> (rec.start - epoch),
+               static_cast<long long> (rec.wall), getpid(), rec.tid);
+      print_json_string (outfile, rec.filename);
+      fprintf (outfile, ",\"cpu_us\":%lld,\"max_rss_kib\":%ld",
+               static_cast<long long> (rec.cpu), rec.max_rss);
+      for (int i = 0; i < NCOUNTERS; ++i) {
+         if (rec.counts[i] < 0) continue;
+         fprintf (outfile, ",\"%s\":%lld", counter_events[i].name,
+                  static_cast<long long> (rec.counts[i]));
+      }
+      fprintf (outfile, "}}");
+      separator = ",\n";
+   }
+   fprintf (outfile, "\n],\"displayTimeUnit\":\"ms\"}\n");
+   fclose (outfile);
+   return true;
+}
+
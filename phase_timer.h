@@ -0,0 +1,66 @@
+#ifndef __PHASE_TIMER_H__
+#define __PHASE_TIMER_H__
+
+#include <mutex>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <stdint.h>
+#include <stdio.h>
+
+//
+// DESCRIPTION
+//    Measures the phases of a compilation.  A phase_timer is
+//    declared at the start of a phase and records it when it goes
+//    out of scope: wall time, CPU time of the calling thread, peak
+//    resident set size, and optionally hardware counters read with
+//    perf_event_open.  Nothing is measured unless --time-report or
+//    --trace asked for it.
+//
+
+struct phase_timer {
+   enum { INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, NCOUNTERS };
+
+   struct record {
+      const char* phase;
+      string filename;
+      long tid;
+      int64_t start;         // microseconds since the first phase
+      int64_t wall;          // microseconds
+      int64_t cpu;           // microseconds, this thread only
+      long max_rss;          // KiB, whole process
+      int64_t counts[NCOUNTERS];  // -1 where unavailable
+   };
+
+   static bool report;       // --time-report
+   static bool counters;     // --time-report=counters
+   static string trace_file; // --trace=file
+   static vector<record> records;
+   static mutex lock;
+
+   phase_timer (const char* phase, const string& filename);
+   ~phase_timer();
+   phase_timer (const phase_timer&) = delete;
+   phase_timer& operator= (const phase_timer&) = delete;
+
+   static bool enabled() { return report or not trace_file.empty(); }
+   static void reset();
+   // Forgets the options and the records of the last command line.
+
+   static void print_report (FILE* outfile);
+   // Sums the records by phase.
+
+   static bool write_trace();
+   // Writes the records in Chrome trace-event format.
+
+   private:
+   record current;
+   bool active;
+   int64_t start_wall;
+   int64_t start_cpu;
+   int fds[NCOUNTERS];
+};
+
+#endif
+
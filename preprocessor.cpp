@@ -0,0 +1,466 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+using namespace std;
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "auxlib.h"
+#include "preprocessor.h"
+
+bool preprocessor::builtin = false;
+
+static const size_t max_include_depth = 200;
+
+static bool is_ident_start (char c) {
+   return isalpha (static_cast<unsigned char> (c)) or c == '_';
+}
+
+static bool is_ident_char (char c) {
+   return isalnum (static_cast<unsigned char> (c)) or c == '_';
+}
+
+static size_t skip_space (const string& text, size_t pos) {
+   while (pos < text.size() and isspace (
+          static_cast<unsigned char> (text[pos]))) ++pos;
+   return pos;
+}
+
+static string trim (const string& text) {
+   size_t begin = skip_space (text, 0);
+   size_t end = text.size();
+   while (end > begin and isspace (
+          static_cast<unsigned char> (text[end - 1]))) --end;
+   return text.substr (begin, end - begin);
+}
+
+//Returns the position after a quoted literal starting at pos.
+static size_t skip_literal (const string& text, size_t pos) {
+   char quote = text[pos++];
+   while (pos < text.size() and text[pos] != quote
+          and text[pos] != '\n') {
+      if (text[pos] == '\\' and pos + 1 < text.size()) ++pos;
+      ++pos;
+   }
+   return pos < text.size() and text[pos] == quote ? pos + 1 : pos;
+}
+
+//Collapses runs of white space outside literals, as cpp does for
+//the body of a macro.
+static string squeeze (const string& text) {
+   string result;
+   size_t pos = 0;
+   while (pos < text.size()) {
+      char c = text[pos];
+      if (c == '"' or c == '\'') {
+         size_t end = skip_literal (text, pos);
+         result.append (text, pos, end - pos);
+         pos = end;
+      }else if (isspace (static_cast<unsigned char> (c))) {
+         pos = skip_space (text, pos);
+         result += ' ';
+      }else {
+         result += c;
+         ++pos;
+      }
+   }
+   return result;
+}
+
+string strip_comments (const string& text) {
+   string result;
+   result.reserve (text.size());
+   size_t pos = 0;
+   while (pos < text.size()) {
+      char c = text[pos];
+      if (c == '"' or c == '\'') {
+         size_t end = skip_literal (text, pos);
+         result.append (text, pos, end - pos);
+         pos = end;
+      }else if (c == '/' and pos + 1 < text.size()
+                and text[pos + 1] == '/') {
+         while (pos < text.size() and text[pos] != '\n') ++pos;
+         result += ' ';
+      }else if (c == '/' and pos + 1 < text.size()
+                and text[pos + 1] == '*') {
+         pos += 2;
+         result += ' ';
+         while (pos < text.size() and not (text[pos] == '*'
+                and pos + 1 < text.size() and text[pos + 1] == '/')) {
+            if (text[pos] == '\n') result += '\n';
+            ++pos;
+         }
+         pos = pos < text.size() ? pos + 2 : pos;
+      }else {
+         result += c;
+         ++pos;
+      }
+   }
+   return result;
+}
+
+preprocessor::preprocessor(): out (nullptr), failed (false) {
+}
+
+void preprocessor::error (const string& file, size_t linenr,
+                          const string& what) {
+   errprintf ("%s:%zu: %s\n", file.c_str(), linenr, what.c_str());
+   failed = true;
+}
+
+bool preprocessor::skipping() const {
+   for (const conditional& cond: conds) {
+      if (not cond.taking) return true;
+   }
+   return false;
+}
+
+bool preprocessor::read_file (const string& path, string& text) {
+   ostringstream buffer;
+   if (path == "-") {
+      buffer << cin.rdbuf();
+   }else {
+      ifstream file (path);
+      if (not file) return false;
+      buffer << file.rdbuf();
+   }
+   text = buffer.str();
+   return true;
+}
+
+bool preprocessor::run (const string& filename, string& output) {
+   string text;
+   out = &output;
+   failed = false;
+   if (not read_file (filename, text)) {
+      syserrprintf (filename.c_str());
+      return false;
+   }
+   string name = filename == "-" ? "<stdin>" : filename;
+   process (name, text);
+   if (not conds.empty()) {
+      error (name, 0, "unterminated conditional directive");
+      conds.clear();
+   }
+   out = nullptr;
+   return not failed;
+}
+
+//Copies text to the output a line at a time, obeying directives.
+void preprocessor::process (const string& path, const string& text) {
+   string source = strip_comments (text);
+   include_stack.push_back (path);
+   size_t depth = conds.size();
+   *out += "# 1 \"" + path + "\"";
+   if (include_stack.size() > 1) *out += " 1";
+   *out += "\n";
+   size_t linenr = 1;
+   size_t pos = 0;
+   while (pos < source.size()) {
+      size_t first_line = linenr;
+      string line;
+      // Join lines ending in a backslash.
+      for(;;) {
+         size_t end = source.find ('\n', pos);
+         if (end == string::npos) end = source.size();
+         line.append (source, pos, end - pos);
+         pos = end < source.size() ? end + 1 : end;
+         if (line.empty() or line.back() != '\\'
+             or pos >= source.size()) break;
+         line.pop_back();
+         ++linenr;
+      }
+      size_t start = skip_space (line, 0);
+      if (start < line.size() and line[start] == '#') {
+         size_t before = out->size();
+         directive (path, first_line, line.substr (start + 1));
+         if (out->size() == before) *out += "\n";
+         else *out += "# " + to_string (linenr + 1) + " \""
+                    + path + "\" 2\n";
+      }else if (skipping()) {
+         *out += "\n";
+      }else {
+         unordered_set<string> active;
+         *out += expand (line, active) + "\n";
+      }
+      for (; first_line < linenr; ++first_line) *out += "\n";
+      ++linenr;
+   }
+   if (conds.size() > depth) {
+      error (path, linenr, "unterminated conditional directive");
+      conds.resize (depth);
+   }
+   include_stack.pop_back();
+}
+
+void preprocessor::directive (const string& path, size_t linenr,
+                              const string& line) {
+   size_t pos = skip_space (line, 0);
+   size_t end = pos;
+   while (end < line.size() and is_ident_char (line[end])) ++end;
+   string name = line.substr (pos, end - pos);
+   string operand = trim (line.substr (end));
+   string ident;
+   for (size_t i = 0; i < operand.size()
+        and is_ident_char (operand[i]); ++i) ident += operand[i];
+
+   if (name == "ifdef" or name == "ifndef") {
+      bool taking = not skipping() and
+                    (macros.count (ident) > 0) == (name == "ifdef");
+      conds.push_back ({taking, taking, false});
+   }else if (name == "if") {
+      bool taking = not skipping()
+                and evaluate (path, linenr, operand);
+      conds.push_back ({taking, taking, false});
+   }else if (name == "elif" or name == "else") {
+      if (conds.empty() or conds.back().seen_else) {
+         error (path, linenr, "#" + name + " without #if");
+         return;
+      }
+      conditional cond = conds.back();
+      conds.pop_back();
+      bool taking = not cond.taken and not skipping()
+                and (name == "else"
+                     or evaluate (path, linenr, operand));
+      conds.push_back ({taking, cond.taken or taking,
+                        name == "else"});
+   }else if (name == "endif") {
+      if (conds.empty()) error (path, linenr, "#endif without #if");
+                    else conds.pop_back();
+   }else if (skipping()) {
+      return;
+   }else if (name == "define") {
+      if (ident.empty() or not is_ident_start (ident[0])) {
+         error (path, linenr, "macro name missing");
+      }else if (ident.size() < operand.size()
+                and operand[ident.size()] == '(') {
+         error (path, linenr, "function-like macro not supported: "
+                              + ident);
+      }else {
+         macros[ident] = squeeze (trim (operand.substr (ident.size())));
+      }
+   }else if (name == "undef") {
+      macros.erase (ident);
+   }else if (name == "include") {
+      include (path, linenr, operand);
+   }else if (name == "error") {
+      error (path, linenr, "#error " + operand);
+   }else if (name == "pragma" or name == "" or isdigit (
+             static_cast<unsigned char> (name[0]))) {
+      // Ignored, as are line markers from an earlier cpp.
+   }else {
+      error (path, linenr, "invalid directive #" + name);
+   }
+}
+
+void preprocessor::include (const string& path, size_t linenr,
+                            const string& operand) {
+   if (operand.size() < 2 or not ((operand.front() == '"'
+       and operand.back() == '"') or (operand.front() == '<'
+       and operand.back() == '>'))) {
+      error (path, linenr, "#include expects \"file\" or <file>");
+      return;
+   }
+   if (include_stack.size() >= max_include_depth) {
+      error (path, linenr, "#include nested too deeply");
+      return;
+   }
+   string name = operand.substr (1, operand.size() - 2);
+   vector<string> candidates;
+   size_t slash = path.rfind ('/');
+   if (name[0] != '/' and slash != string::npos) {
+      candidates.push_back (path.substr (0, slash + 1) + name);
+   }
+   candidates.push_back (name);
+   for (const string& candidate: candidates) {
+      string text;
+      if (read_file (candidate, text)) {
+         process (candidate, text);
+         return;
+      }
+   }
+   error (path, linenr, name + ": No such file or directory");
+}
+
+//Replaces object-like macros, leaving literals alone.
+string preprocessor::expand (const string& text,
+                             unordered_set<string>& active) {
+   string result;
+   size_t pos = 0;
+   while (pos < text.size()) {
+      char c = text[pos];
+      if (c == '"' or c == '\'') {
+         size_t end = skip_literal (text, pos);
+         result.append (text, pos, end - pos);
+         pos = end;
+      }else if (is_ident_start (c)) {
+         size_t end = pos;
+         while (end < text.size() and is_ident_char (text[end])) ++end;
+         string ident = text.substr (pos, end - pos);
+         auto macro = macros.find (ident);
+         if (macro == macros.end() or active.count (ident)) {
+            result += ident;
+         }else {
+            active.insert (ident);
+            result += expand (macro->second, active);
+            active.erase (ident);
+         }
+         pos = end;
+      }else if (isdigit (static_cast<unsigned char> (c))) {
+         while (pos < text.size() and is_ident_char (text[pos])) {
+            result += text[pos++];
+         }
+      }else {
+         result += c;
+         ++pos;
+      }
+   }
+   return result;
+}
+
+//
+// Evaluation of #if expressions by recursive descent.  Operands
+// are integers, and identifiers left after expansion count as 0.
+//
+namespace {
+struct if_expr {
+   const string& text;
+   size_t pos;
+   bool bad;
+
+   void space() { pos = skip_space (text, pos); }
+   bool accept (const char* op) {
+      space();
+      size_t len = strlen (op);
+      if (text.compare (pos, len, op) != 0) return false;
+      if (len == 1 and pos + 1 < text.size()
+          and (op[0] == '<' or op[0] == '>' or op[0] == '!'
+               or op[0] == '=' or op[0] == '&' or op[0] == '|')
+          and text[pos + 1] == (op[0] == '&' or op[0] == '|'
+                                ? op[0] : '=')) return false;
+      pos += len;
+      return true;
+   }
+   long primary() {
+      space();
+      if (accept ("(")) {
+         long value = logical_or();
+         if (not accept (")")) bad = true;
+         return value;
+      }
+      if (accept ("!")) return not primary();
+      if (accept ("-")) return - primary();
+      if (accept ("+")) return primary();
+      if (pos < text.size() and isdigit (
+          static_cast<unsigned char> (text[pos]))) {
+         char* end = nullptr;
+         long value = strtol (text.c_str() + pos, &end, 0);
+         pos = end - text.c_str();
+         while (pos < text.size() and is_ident_char (text[pos])) ++pos;
+         return value;
+      }
+      if (pos < text.size() and is_ident_start (text[pos])) {
+         while (pos < text.size() and is_ident_char (text[pos])) ++pos;
+         return 0;
+      }
+      bad = true;
+      return 0;
+   }
+   long multiplicative() {
+      long value = primary();
+      for(;;) {
+         if (accept ("*")) value *= primary();
+         else if (accept ("/") or accept ("%")) {
+            bool divide = text[pos - 1] == '/';
+            long right = primary();
+            if (right == 0) { bad = true; return 0; }
+            value = divide ? value / right : value % right;
+         }else return value;
+      }
+   }
+   long additive() {
+      long value = multiplicative();
+      for(;;) {
+         if (accept ("+")) value += multiplicative();
+         else if (accept ("-")) value -= multiplicative();
+         else return value;
+      }
+   }
+   long relational() {
+      long value = additive();
+      for(;;) {
+         if (accept ("<=")) value = value <= additive();
+         else if (accept (">=")) value = value >= additive();
+         else if (accept ("<")) value = value < additive();
+         else if (accept (">")) value = value > additive();
+         else return value;
+      }
+   }
+   long equality() {
+      long value = relational();
+      for(;;) {
+         if (accept ("==")) value = value == relational();
+         else if (accept ("!=")) value = value != relational();
+         else return value;
+      }
+   }
+   long logical_and() {
+      long value = equality();
+      while (accept ("&&")) {
+         long right = equality();
+         value = value and right;
+      }
+      return value;
+   }
+   long logical_or() {
+      long value = logical_and();
+      while (accept ("||")) {
+         long right = logical_and();
+         value = value or right;
+      }
+      return value;
+   }
+};
+}
+
+long preprocessor::evaluate (const string& path, size_t linenr,
+                             const string& expr) {
+   // Replace defined(X) and defined X before expanding macros.
+   string resolved;
+   size_t pos = 0;
+   while (pos < expr.size()) {
+      if (expr.compare (pos, 7, "defined") == 0
+          and (pos == 0 or not is_ident_char (expr[pos - 1]))
+          and (pos + 7 == expr.size()
+               or not is_ident_char (expr[pos + 7]))) {
+         size_t at = skip_space (expr, pos + 7);
+         bool paren = at < expr.size() and expr[at] == '(';
+         if (paren) at = skip_space (expr, at + 1);
+         size_t end = at;
+         while (end < expr.size() and is_ident_char (expr[end])) ++end;
+         string ident = expr.substr (at, end - at);
+         if (paren) {
+            end = skip_space (expr, end);
+            if (end < expr.size() and expr[end] == ')') ++end;
+         }
+         resolved += macros.count (ident) ? " 1 " : " 0 ";
+         pos = end;
+      }else {
+         resolved += expr[pos++];
+      }
+   }
+   unordered_set<string> active;
+   string expanded = expand (resolved, active);
+   if_expr parse {expanded, 0, false};
+   long value = parse.logical_or();
+   parse.space();
+   if (parse.bad or parse.pos != expanded.size()) {
+      error (path, linenr, "invalid #if expression: " + expr);
+      return 0;
+   }
+   return value;
+}
+
@@ -0,0 +1,57 @@
+#ifndef __PREPROCESSOR_H__
+#define __PREPROCESSOR_H__
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+using namespace std;
+
+//
+// DESCRIPTION
+//    Built-in replacement for /usr/bin/cpp, enough for oc programs.
+//    Handles #include, object-like #define and #undef, and the
+//    conditionals #if, #ifdef, #ifndef, #elif, #else and #endif.
+//    Comments are removed.  The output carries the same
+//    `# N "file"' line markers as cpp, and is built in memory.
+//
+
+struct preprocessor {
+   static bool builtin;      // use this instead of cpp (-p)
+
+   preprocessor();
+   bool run (const string& filename, string& output);
+   // Preprocesses filename ("-" for stdin) into output.
+   // Returns false if an error was reported.
+
+   private:
+   struct conditional {
+      bool taking;           // this branch's lines are kept
+      bool taken;            // some branch has been kept already
+      bool seen_else;
+   };
+   unordered_map<string, string> macros;
+   vector<conditional> conds;
+   vector<string> include_stack;
+   string* out;
+   bool failed;
+
+   void error (const string& file, size_t linenr, const string& what);
+   bool skipping() const;
+   bool read_file (const string& path, string& text);
+   void process (const string& path, const string& text);
+   void directive (const string& path, size_t linenr,
+                   const string& line);
+   void include (const string& path, size_t linenr,
+                 const string& operand);
+   string expand (const string& text, unordered_set<string>& active);
+   long evaluate (const string& path, size_t linenr,
+                  const string& expr);
+};
+
+string strip_comments (const string& text);
+// Replaces each comment by a space, keeping newlines
+// so that line numbers are unchanged.
+
+#endif
+
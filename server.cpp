@@ -0,0 +1,295 @@
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "auxlib.h"
+#include "lyutils.h"
+#include "server.h"
+#include "string_set.h"
+
+//
+// Messages are lists of strings.  A list is sent as a 32-bit count
+// followed by each string as a 32-bit length and its bytes.
+//
+// A request is:  working directory, "1" if the client's stdin and
+//                stdout are terminals, the client's $OC_CACHE_DIR,
+//                then the command line.  It is preceded by the
+//                client's stdin, passed as a descriptor, which the
+//                server reads as its own for the request.
+// A response is: exit status, stdout text, stderr text, then the
+//                names of the files written.
+//
+
+// The string set is sized for a large program up front, and its
+// buckets are kept from one request to the next.
+static const size_t string_set_reserve = 1 << 16;
+
+static bool write_all (int fd, const void* data, size_t size) {
+   const char* bytes = static_cast<const char*> (data);
+   while (size > 0) {
+      ssize_t count = write (fd, bytes, size);
+      if (count < 0 and errno == EINTR) continue;
+      if (count <= 0) return false;
+      bytes += count;
+      size -= count;
+   }
+   return true;
+}
+
+static bool read_all (int fd, void* data, size_t size) {
+   char* bytes = static_cast<char*> (data);
+   while (size > 0) {
+      ssize_t count = read (fd, bytes, size);
+      if (count < 0 and errno == EINTR) continue;
+      if (count <= 0) return false;
+      bytes += count;
+      size -= count;
+   }
+   return true;
+}
+
+static bool send_strings (int fd, const vector<string>& strings) {
+   uint32_t count = strings.size();
+   if (not write_all (fd, &count, sizeof count)) return false;
+   for (const string& str: strings) {
+      uint32_t size = str.size();
+      if (not write_all (fd, &size, sizeof size)
+       or not write_all (fd, str.data(), size)) return false;
+   }
+   return true;
+}
+
+static bool recv_strings (int fd, vector<string>& strings) {
+   uint32_t count;
+   if (not read_all (fd, &count, sizeof count)) return false;
+   strings.resize (count);
+   for (string& str: strings) {
+      uint32_t size;
+      if (not read_all (fd, &size, sizeof size)) return false;
+      str.resize (size);
+      if (not read_all (fd, &str[0], size)) return false;
+   }
+   return true;
+}
+
+//Sends fd as SCM_RIGHTS data along with a single byte.
+static bool send_fd (int socket_fd, int fd) {
+   char byte = 0;
+   iovec data {&byte, 1};
+   alignas (cmsghdr) char control[CMSG_SPACE (sizeof fd)] {};
+   msghdr message {};
+   message.msg_iov = &data;
+   message.msg_iovlen = 1;
+   message.msg_control = control;
+   message.msg_controllen = sizeof control;
+   cmsghdr* header = CMSG_FIRSTHDR (&message);
+   header->cmsg_level = SOL_SOCKET;
+   header->cmsg_type = SCM_RIGHTS;
+   header->cmsg_len = CMSG_LEN (sizeof fd);
+   memcpy (CMSG_DATA (header), &fd, sizeof fd);
+   for(;;) {
+      ssize_t count = sendmsg (socket_fd, &message, 0);
+      if (count < 0 and errno == EINTR) continue;
+      return count == 1;
+   }
+}
+
+//Receives a descriptor sent by send_fd, or returns -1.
+static int recv_fd (int socket_fd) {
+   char byte;
+   iovec data {&byte, 1};
+   int fd = -1;
+   alignas (cmsghdr) char control[CMSG_SPACE (sizeof fd)] {};
+   msghdr message {};
+   message.msg_iov = &data;
+   message.msg_iovlen = 1;
+   message.msg_control = control;
+   message.msg_controllen = sizeof control;
+   for(;;) {
+      ssize_t count = recvmsg (socket_fd, &message, MSG_CMSG_CLOEXEC);
+      if (count < 0 and errno == EINTR) continue;
+      if (count != 1) return -1;
+      break;
+   }
+   cmsghdr* header = CMSG_FIRSTHDR (&message);
+   if (header == nullptr or header->cmsg_level != SOL_SOCKET
+    or header->cmsg_type != SCM_RIGHTS) return -1;
+   memcpy (&fd, CMSG_DATA (header), sizeof fd);
+   return fd;
+}
+
+static bool make_address (const char* socket_path, sockaddr_un& addr) {
+   memset (&addr, 0, sizeof addr);
+   addr.sun_family = AF_UNIX;
+   if (strlen (socket_path) >= sizeof addr.sun_path) {
+      errprintf ("%:%s: socket path too long\n", socket_path);
+      return false;
+   }
+   strcpy (addr.sun_path, socket_path);
+   return true;
+}
+
+static string slurp (FILE* file) {
+   string text;
+   char buffer[0x1000];
+   rewind (file);
+   for(;;) {
+      size_t count = fread (buffer, 1, sizeof buffer, file);
+      if (count == 0) break;
+      text.append (buffer, count);
+   }
+   return text;
+}
+
+//Runs one command line with the client's stdin as stdin and with
+//stdout and stderr sent to temporary files, and returns what was
+//written there.
+static vector<string> run_request (vector<string>& request,
+                                   int client_in) {
+   vector<char*> argv;
+   for (size_t arg = 3; arg < request.size(); ++arg) {
+      argv.push_back (&request[arg][0]);
+   }
+   argv.push_back (nullptr);
+   vector<string> artifacts;
+   FILE* out = tmpfile();
+   FILE* err = tmpfile();
+   if (out == nullptr or err == nullptr) {
+      syserrprintf ("tmpfile");
+      if (out != nullptr) fclose (out);
+      if (err != nullptr) fclose (err);
+      return {to_string (EXIT_FAILURE), "", "tmpfile failed\n"};
+   }
+   fflush (nullptr);
+   int saved_in = dup (STDIN_FILENO);
+   int saved_out = dup (STDOUT_FILENO);
+   int saved_err = dup (STDERR_FILENO);
+   dup2 (client_in, STDIN_FILENO);
+   dup2 (fileno (out), STDOUT_FILENO);
+   dup2 (fileno (err), STDERR_FILENO);
+   if (request[2].empty()) {
+      unsetenv ("OC_CACHE_DIR");
+   }else {
+      setenv ("OC_CACHE_DIR", request[2].c_str(), 1);
+   }
+
+   exec::exit_status = EXIT_SUCCESS;
+   if (chdir (request[0].c_str()) != 0) {
+      syserrprintf (request[0].c_str());
+   }else {
+      lexer::interactive = request[1] == "1";
+      string_set::reset();
+      exec::exit_status = compile_main (argv.size() - 1, argv.data(),
+                                        &artifacts);
+   }
+   int status = exec::exit_status;
+
+   fflush (nullptr);
+   dup2 (saved_in, STDIN_FILENO);
+   dup2 (saved_out, STDOUT_FILENO);
+   dup2 (saved_err, STDERR_FILENO);
+   close (saved_in);
+   close (saved_out);
+   close (saved_err);
+   // Forget that the client's input reached end of file.
+   clearerr (stdin);
+   cin.clear();
+   vector<string> response {to_string (status),
+                            slurp (out), slurp (err)};
+   fclose (out);
+   fclose (err);
+   response.insert (response.end(), artifacts.begin(), artifacts.end());
+   return response;
+}
+
+int compile_server::serve (const char* socket_path) {
+   sockaddr_un addr;
+   if (not make_address (socket_path, addr)) return exec::exit_status;
+   signal (SIGPIPE, SIG_IGN);
+   int listener = socket (AF_UNIX, SOCK_STREAM, 0);
+   if (listener < 0) {
+      syserrprintf ("socket");
+      return exec::exit_status;
+   }
+   unlink (socket_path);
+   if (bind (listener, reinterpret_cast<sockaddr*> (&addr),
+             sizeof addr) != 0 or listen (listener, 16) != 0) {
+      syserrprintf (socket_path);
+      close (listener);
+      return exec::exit_status;
+   }
+   string_set::reserve (string_set_reserve);
+   for(;;) {
+      int client = accept (listener, nullptr, nullptr);
+      if (client < 0) {
+         if (errno == EINTR) continue;
+         syserrprintf ("accept");
+         break;
+      }
+      int client_in = recv_fd (client);
+      vector<string> request;
+      if (client_in >= 0 and recv_strings (client, request)
+       and request.size() >= 4) {
+         send_strings (client, run_request (request, client_in));
+      }
+      if (client_in >= 0) close (client_in);
+      close (client);
+   }
+   close (listener);
+   unlink (socket_path);
+   return exec::exit_status;
+}
+
+int compile_server::request (const char* socket_path,
+                             int argc, char** argv) {
+   sockaddr_un addr;
+   if (not make_address (socket_path, addr)) return exec::exit_status;
+   int server = socket (AF_UNIX, SOCK_STREAM, 0);
+   if (server < 0
+    or connect (server, reinterpret_cast<sockaddr*> (&addr),
+                sizeof addr) != 0) {
+      syserrprintf (socket_path);
+      if (server >= 0) close (server);
+      return exec::exit_status;
+   }
+   char cwd[PATH_MAX];
+   if (getcwd (cwd, sizeof cwd) == nullptr) {
+      syserrprintf ("getcwd");
+      close (server);
+      return exec::exit_status;
+   }
+   bool interactive = isatty (fileno (stdin))
+                  and isatty (fileno (stdout));
+   const char* cache_dir = getenv ("OC_CACHE_DIR");
+   vector<string> request {cwd, interactive ? "1" : "0",
+                           cache_dir == nullptr ? "" : cache_dir};
+   request.insert (request.end(), &argv[0], &argv[argc]);
+   vector<string> response;
+   if (not send_fd (server, STDIN_FILENO)
+    or not send_strings (server, request)
+    or not recv_strings (server, response) or response.size() < 3) {
+      errprintf ("%:%s: no response from server\n", socket_path);
+      close (server);
+      return exec::exit_status;
+   }
+   close (server);
+   // response[3] onward name the files written; the command line
+   // client has no use for them, but other clients do.
+   fwrite (response[1].data(), 1, response[1].size(), stdout);
+   fwrite (response[2].data(), 1, response[2].size(), stderr);
+   return atoi (response[0].c_str());
+}
+
@@ -0,0 +1,32 @@
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <string>
+#include <vector>
+using namespace std;
+
+//
+// DESCRIPTION
+//    Compile server.  `oc --server socket' stays running and
+//    compiles the command lines sent to it by `oc --client socket',
+//    so that process startup, static tables and the string set are
+//    paid for once.  The client's stdin and $OC_CACHE_DIR are
+//    used for its request.  The client prints the server's stdout
+//    and stderr and exits with its status, just as oc would have.
+//
+
+struct compile_server {
+   static int serve (const char* socket_path);
+   // Accepts requests one at a time until killed.
+
+   static int request (const char* socket_path, int argc, char** argv);
+   // Sends a command line to the server and reproduces its output.
+};
+
+int compile_main (int argc, char** argv,
+                  vector<string>* artifacts = nullptr);
+// Compiles as directed by a command line.  Defined in main.cpp.
+// Appends the names of the files written to artifacts.
+
+#endif
+
@@ -1,45 +1,268 @@
 // $Id: string_set.cpp,v 1.5 2019-03-15 14:32:40-07 - - $
 
-#include <string>
-#include <unordered_set>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
 using namespace std;
 
+#include <stdint.h>
+#include <string.h>
+
+#include "arena.h"
 #include "auxlib.h"
 #include "string_set.h"
 
-unordered_set<string> string_set::set;
+//A table entry is a record and its hash, or a null record if the
+//entry is empty.  The hash is written before the record is
+//published, so a reader that sees the record sees the hash.
+struct slot {
+   atomic<const interned*> entry;
+   uint32_t hash;
+};
+
+struct table {
+   size_t mask;
+   unique_ptr<slot[]> slots;
+   table (size_t size): mask (size - 1), slots (new slot[size]()) {}
+};
+
+//A shard holds the strings whose hashes share their top bits.
+//Readers probe its current table with no lock; a table that grows
+//is replaced, and the old one is kept until reset, since a reader
+//may still be probing it.
+struct alignas (64) shard {
+   mutex lock;
+   atomic<table*> current {nullptr};
+   vector<unique_ptr<table>> tables;  // the last is current
+   size_t count = 0;
+   arena storage;
+};
+
+static constexpr uint32_t SHARD_BITS = 6;
+static constexpr size_t SHARDS = size_t (1) << SHARD_BITS;
+static constexpr size_t MIN_SLOTS = 256;
+static constexpr uint32_t ID_BITS = 12;
+static constexpr uint32_t ID_CHUNK = uint32_t (1) << ID_BITS;
+static constexpr size_t MAX_ID_CHUNKS = size_t (1) << (32 - ID_BITS);
+
+static shard shards[SHARDS];
+static atomic<uint32_t> next_id {0};
+// Records by id, in chunks that are never moved or freed, so that
+// lookup needs no lock.
+static atomic<const interned**> id_chunks[MAX_ID_CHUNKS];
+static mutex chunk_lock;
+
+thread_local vector<bool>* string_set::used = nullptr;
+
+//Mixes eight bytes at a time, reading the tail as a short word.
+static uint32_t hash_bytes (const char* text, size_t length) {
+   const uint64_t multiplier = 0xff51afd7ed558ccdULL;
+   uint64_t hash = length * 0x9e3779b97f4a7c15ULL;
+   for (; length >= 8; text += 8, length -= 8) {
+      uint64_t word;
+      memcpy (&word, text, 8);
+      hash = (hash ^ word) * multiplier;
+      hash ^= hash >> 32;
+   }
+   if (length > 0) {
+      uint64_t word = 0;
+      memcpy (&word, text, length);
+      hash = (hash ^ word) * multiplier;
+   }
+   hash ^= hash >> 29;
+   hash *= 0xc4ceb9fe1a85ec53ULL;
+   hash ^= hash >> 32;
+   return static_cast<uint32_t> (hash);
+}
+
+//Probes for text, returning its record, or nullptr and the empty
+//slot where it would go.
+static const interned* find (const table* probing, const char* text,
+                             size_t length, uint32_t hash,
+                             slot** empty = nullptr) {
+   for (size_t index = hash & probing->mask;;
+        index = (index + 1) & probing->mask) {
+      slot& probe = probing->slots[index];
+      const interned* entry = probe.entry.load (memory_order_acquire);
+      if (entry == nullptr) {
+         if (empty != nullptr) *empty = &probe;
+         return nullptr;
+      }
+      if (probe.hash == hash and entry->length == length
+       and memcmp (entry->c_str(), text, length) == 0) return entry;
+   }
+}
+
+static void grow (shard& home, size_t size) {
+   const table* old = home.current.load (memory_order_relaxed);
+   unique_ptr<table> grown (new table (size));
+   if (old != nullptr) {
+      for (size_t index = 0; index <= old->mask; ++index) {
+         const slot& entry = old->slots[index];
+         const interned* record = entry.entry.load (
+                                  memory_order_relaxed);
+         if (record == nullptr) continue;
+         size_t probe = entry.hash & grown->mask;
+         while (grown->slots[probe].entry.load (memory_order_relaxed)
+                != nullptr) probe = (probe + 1) & grown->mask;
+         grown->slots[probe].hash = entry.hash;
+         grown->slots[probe].entry.store (record,
+                                          memory_order_relaxed);
+      }
+   }
+   home.current.store (grown.get(), memory_order_release);
+   home.tables.push_back (move (grown));
+}
+
+static void set_id (uint32_t id, const interned* entry) {
+   atomic<const interned**>& chunk = id_chunks[id >> ID_BITS];
+   const interned** entries = chunk.load (memory_order_acquire);
+   if (entries == nullptr) {
+      lock_guard<mutex> guard (chunk_lock);
+      entries = chunk.load (memory_order_relaxed);
+      if (entries == nullptr) {
+         entries = new const interned*[ID_CHUNK]();
+         chunk.store (entries, memory_order_release);
+      }
+   }
+   entries[id & (ID_CHUNK - 1)] = entry;
+}
 
-string_set::string_set() {
-   set.max_load_factor (0.5);
+//Adds text to home, whose lock is held, unless another thread
+//added it after it was looked for.
+static const interned* add (shard& home, const char* text,
+                            size_t length, uint32_t hash) {
+   if (home.current.load (memory_order_relaxed) == nullptr) {
+      grow (home, MIN_SLOTS);
+   }
+   const table* current = home.current.load (memory_order_relaxed);
+   slot* empty = nullptr;
+   const interned* found = find (current, text, length, hash, &empty);
+   if (found != nullptr) return found;
+   uint32_t id = next_id.fetch_add (1, memory_order_relaxed);
+   if (id == UINT32_MAX) throw bad_alloc();
+   void* memory = home.storage.allocate (
+                  sizeof (interned) + length + 1, alignof (interned));
+   interned* entry = static_cast<interned*> (memory);
+   *entry = {id, static_cast<uint32_t> (length), hash};
+   char* bytes = reinterpret_cast<char*> (entry + 1);
+   memcpy (bytes, text, length);
+   bytes[length] = '\0';
+   set_id (id, entry);
+   empty->hash = hash;
+   empty->entry.store (entry, memory_order_release);
+   size_t size = current->mask + 1;
+   if (++home.count * 2 > size) grow (home, size * 2);
+   DEBUGF ('s', "interned %u \"%s\"\n", id, entry->c_str());
+   return entry;
 }
 
-const string* string_set::intern (const char* string) {
-   auto handle = set.insert (string);
-   DEBUGF ('s', "inserted \"%s\" %s\n", handle.first->c_str(),
-           handle.second ? "newly inserted" : "already there");
-   return &*handle.first;
+static const interned* find_or_add (const char* text, size_t length) {
+   uint32_t hash = hash_bytes (text, length);
+   shard& home = shards[hash >> (32 - SHARD_BITS)];
+   const table* current = home.current.load (memory_order_acquire);
+   if (current != nullptr) {
+      const interned* found = find (current, text, length, hash);
+      if (found != nullptr) return found;
+   }
+   lock_guard<mutex> guard (home.lock);
+   return add (home, text, length, hash);
+}
+
+const interned* string_set::intern (const char* text, size_t length) {
+   const interned* entry = find_or_add (text, length);
+   if (used != nullptr) {
+      if (entry->id >= used->size()) used->resize (entry->id + 1);
+      (*used)[entry->id] = true;
+   }
+   return entry;
+}
+
+const interned* string_set::intern (const char* text) {
+   return intern (text, strlen (text));
+}
+
+const interned* string_set::lookup (uint32_t id) {
+   const interned** entries = id_chunks[id >> ID_BITS].load (
+                              memory_order_acquire);
+   return entries[id & (ID_CHUNK - 1)];
+}
+
+size_t string_set::size() {
+   return next_id.load (memory_order_acquire);
+}
+
+void string_set::reserve (size_t count) {
+   size_t wanted = MIN_SLOTS;
+   while (wanted < (count / SHARDS + 1) * 2) wanted *= 2;
+   for (shard& home: shards) {
+      lock_guard<mutex> guard (home.lock);
+      const table* current = home.current.load (memory_order_relaxed);
+      if (current == nullptr or current->mask + 1 < wanted) {
+         grow (home, wanted);
+      }
+   }
+}
+
+//No other thread may be interning, or holding a record.
+void string_set::reset() {
+   for (shard& home: shards) {
+      lock_guard<mutex> guard (home.lock);
+      if (home.tables.empty()) continue;
+      home.tables.erase (home.tables.begin(), home.tables.end() - 1);
+      table& current = *home.tables.back();
+      for (size_t index = 0; index <= current.mask; ++index) {
+         current.slots[index].entry.store (nullptr,
+                                           memory_order_relaxed);
+      }
+      home.count = 0;
+      home.storage.reset();
+   }
+   next_id.store (0, memory_order_release);
+}
+
+//Lists strings in byte order, so that the listing is the same
+//however the threads that interned them were scheduled.
+static void print_sorted (FILE* out, vector<const interned*>& entries) {
+   sort (entries.begin(), entries.end(),
+         [] (const interned* left, const interned* right) {
+            return left->view() < right->view();
+         });
+   for (const interned* entry: entries) {
+      fprintf (out, "string_set: %10u \"%s\"\n", entry->hash,
+               entry->c_str());
+   }
+   fprintf (out, "strings = %zu\n", entries.size());
+}
+
+void string_set::dump (FILE* out, const vector<bool>& marked) {
+   vector<const interned*> entries;
+   for (uint32_t id = 0; id < marked.size(); ++id) {
+      if (marked[id]) entries.push_back (lookup (id));
+   }
+   print_sorted (out, entries);
 }
 
 void string_set::dump (FILE* out) {
-   static unordered_set<string>::hasher hash_fn
-               = string_set::set.hash_function();
-   size_t max_bucket_size = 0;
-   for (size_t bucket = 0; bucket < set.bucket_count(); ++bucket) {
-      bool need_index = true;
-      size_t curr_size = set.bucket_size (bucket);
-      if (max_bucket_size < curr_size) max_bucket_size = curr_size;
-      for (auto itor = set.cbegin (bucket);
-           itor != set.cend (bucket); ++itor) {
-         if (need_index) fprintf (out, "string_set[%4zu]: ", bucket);
-                    else fprintf (out, "          %4s   ", "");
-         need_index = false;
-         const string* str = &*itor;
-         fprintf (out, "%22zu %p->\"%s\"\n", hash_fn(*str),
-                  reinterpret_cast<const void*> (str), str->c_str());
+   vector<const interned*> entries;
+   size_t slots = 0;
+   for (shard& home: shards) {
+      lock_guard<mutex> guard (home.lock);
+      const table* current = home.current.load (memory_order_relaxed);
+      if (current == nullptr) continue;
+      slots += current->mask + 1;
+      for (size_t index = 0; index <= current->mask; ++index) {
+         const interned* entry = current->slots[index].entry.load (
+                                 memory_order_relaxed);
+         if (entry != nullptr) entries.push_back (entry);
       }
    }
-   fprintf (out, "load_factor = %.3f\n", set.load_factor());
-   fprintf (out, "bucket_count = %zu\n", set.bucket_count());
-   fprintf (out, "max_bucket_size = %zu\n", max_bucket_size);
+   print_sorted (out, entries);
+   fprintf (out, "shards = %zu\n", SHARDS);
+   fprintf (out, "load_factor = %.3f\n",
+            slots == 0 ? 0.0 : double (entries.size()) / slots);
 }
 
@@ -4,16 +4,69 @@
 #define __STRING_SET__
 
 #include <string>
-#include <unordered_set>
+#include <string_view>
+#include <vector>
 using namespace std;
 
+#include <stdint.h>
 #include <stdio.h>
 
+//
+// DESCRIPTION
+//    The interned strings of a compilation, shared by all of its
+//    threads.  Each distinct string is stored once, in an arena, as
+//    an interned record: a header of id, length and hash, followed
+//    by the NUL-terminated bytes.  Records never move, so two
+//    interned strings are equal exactly when their records are the
+//    same.  Ids are dense, numbered from 0 in the order strings are
+//    first seen on any thread, and lookup finds the record of an id
+//    in constant time.  The strings are split among shards by hash,
+//    each an open addressed table with linear probing, at most half
+//    full, with its own lock and arena.  A string already interned
+//    is found with no lock; only adding one locks its shard.
+//
+
+struct interned {
+   uint32_t id;
+   uint32_t length;
+   uint32_t hash;
+   const char* c_str() const {
+      return reinterpret_cast<const char*> (this + 1);
+   }
+   size_t size() const { return length; }
+   string_view view() const { return {c_str(), length}; }
+   string str() const { return {c_str(), length}; }
+};
+
 struct string_set {
-   string_set();
-   static unordered_set<string> set;
-   static const string* intern (const char*);
+   static const interned* intern (const char* text, size_t length);
+   static const interned* intern (const char* text);
+   // Finds or adds text, whose id is that of the record returned.
+
+   static const interned* lookup (uint32_t id);
+   static string_view view (uint32_t id) { return lookup (id)->view(); }
+   // The record, or the text, of a string already interned.
+
+   static size_t size();
+   // The number of strings interned, one more than the last id.
+
    static void dump (FILE*);
+   // Lists all the strings in byte order, with the table's load.
+
+   static void dump (FILE*, const vector<bool>& marked);
+   // Lists just the strings whose ids are marked, as in a .str file.
+
+   static thread_local vector<bool>* used;
+   // If set, the id of each string interned on this thread is
+   // marked in it, so a compilation can list the strings it used.
+
+   static void reserve (size_t count);
+   // Grows the tables to hold count strings without growing again.
+
+   static void reset();
+   // Empties the set but keeps its tables and the first block of
+   // each arena, for reuse by the next compilation in a
+   // long-running process.  Ids are numbered from 0 again.
 };
 
 #endif
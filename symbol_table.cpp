@@ -1,70 +1,182 @@
 #include <string.h>
 #include <iostream>
+#include <new>
+#include <type_traits>
 #include <vector>
 #include <algorithm>
 
 #include "astree.h"
 #include "lyutils.h"
 #include "symbol_table.h"
+#include "visitor.h"
 
 #define NO_SEQ 0xffffffff
 
-enum class types;
-const string attr_to_string (size_t attri);
+//Token codes from parser.y, listed in yytokens.h by the Makefile.
+static constexpr int token_codes[] {
+#define TOKEN(name) name,
+#include "yytokens.h"
+#undef TOKEN
+};
+
+static constexpr int token_limit() {
+   int limit = 256;
+   for(int code: token_codes)
+      if(code >= limit)
+         limit = code + 1;
+   return limit;
+}
+
+//What the checker needs to know about a token: the kind of node
+//it is, and the base type it declares.
+struct token_info {
+   types type = types::NOMATTER;
+   attr basetype = attr::STRUCT;
+};
 
-//Defnies function types to be used while
-//generating the symbol table
+//Defines function types to be used while generating the symbol
+//table, indexed by token code instead of by token name.
 //Modeled after code provided by Wesley Mackey
-types type_name_hash(const char* token){
-   static const unordered_map<string, types> hash{
-      {"'='",           types::ASSIGN   },
-      {"'+'",           types::BINOP    },
-      {"'-'",           types::BINOP    },
-      {"'*'",           types::BINOP    },
-      {"'/'",           types::BINOP    },
-      {"'%'",           types::BINOP    },
-      {"TOK_CALL",      types::CALL     },
-      {"TOK_EQ",        types::COMPARE  },
-      {"TOK_NQ",        types::COMPARE  },
-      {"'<'",           types::COMPARE  },
-      {"'>'",           types::COMPARE  },
-      {"TOK_LE",        types::COMPARE  },
-      {"TOK_GE",        types::COMPARE  },
-      {"TOK_ARROW",     types::FIELD    },
-      {"TOK_IDENT",     types::IDENT    },
-      {"TOK_INDEX",     types::INDEX    },
-      {"TOK_CHARCON",   types::INTCON   },
-      {"TOK_INTCON",    types::INTCON   },
-      {"TOK_NULLPTR_T", types::NULLPTR  },
-      {"TOK_PTR",       types::PTR      },
-      {"TOK_RETURN",    types::RETURN   },
-      {"TOK_STRINGCON", types::STRCON   },
-      {"TOK_TYPEID",    types::TYPEID   },
-      {"TOK_POS",       types::UNOP     },
-      {"TOK_NEG",       types::UNOP     },
-      {"TOK_NOT",       types::UNOP     },
-      {"TOK_VARDECL",   types::VARDECL  }
-   };
-   auto iter = hash.find(string(token));
-
-   if(iter != hash.end())
-      return iter->second;
-
-   return types::NOMATTER;
-
-   throw invalid_argument (string (__PRETTY_FUNCTION__)
-                           + ":" + string (token));  
-}
-
-//Prints the symbol table to an output file
+struct token_table {
+   token_info info[token_limit()];
+
+   constexpr token_table(): info{} {
+      info['='].type = types::ASSIGN;
+      info['+'].type = types::BINOP;
+      info['-'].type = types::BINOP;
+      info['*'].type = types::BINOP;
+      info['/'].type = types::BINOP;
+      info['%'].type = types::BINOP;
+      info[TOK_CALL].type = types::CALL;
+      info[TOK_EQ].type = types::COMPARE;
+      info[TOK_LE].type = types::COMPARE;
+      info[TOK_GE].type = types::COMPARE;
+      info[TOK_ARROW].type = types::FIELD;
+      info[TOK_IDENT].type = types::IDENT;
+      info[TOK_INDEX].type = types::INDEX;
+      info[TOK_CHARCON].type = types::INTCON;
+      info[TOK_INTCON].type = types::INTCON;
+      info[TOK_PTR].type = types::PTR;
+      info[TOK_RETURN].type = types::RETURN;
+      info[TOK_STRINGCON].type = types::STRCON;
+      info[TOK_TYPEID].type = types::TYPEID;
+      info[TOK_POS].type = types::UNOP;
+      info[TOK_NEG].type = types::UNOP;
+      info[TOK_NOT].type = types::UNOP;
+      info[TOK_VARDECL].type = types::VARDECL;
+      info[TOK_INT].basetype = attr::INT;
+      info[TOK_STRING].basetype = attr::STRING;
+      info[TOK_ARRAY].basetype = attr::ARRAY;
+      info[TOK_VOID].basetype = attr::VOID;
+   }
+
+   constexpr const token_info& operator[](int symbol) const {
+      return symbol >= 0 && symbol < token_limit()
+           ? info[symbol] : info[0];
+   }
+};
+
+static constexpr token_table tokens;
+
+static constexpr size_t MIN_SLOTS = 16;
+
+symbol_table::symbol_table(arena* pool):
+              slots(MIN_SLOTS, {NONE, NONE},
+                    arena_allocator<slot>(pool)),
+              log(arena_allocator<binding>(pool)),
+              marks(arena_allocator<uint32_t>(pool)) {
+   shift = 32;
+   for(size_t size = MIN_SLOTS; size > 1; size >>= 1)
+      --shift;
+   keys = 0;
+}
+
+//Finds the slot of an id, or the empty slot where it would go.
+//Fibonacci hashing spreads runs of dense ids over the table.
+const symbol_table::slot* symbol_table::probe(uint32_t id) const {
+   size_t mask = slots.size() - 1;
+   for(size_t i = uint32_t(id * 2654435769u) >> shift;;
+       i = (i + 1) & mask){
+      const slot& entry = slots[i];
+      if(entry.id == id || entry.id == NONE)
+         return &entry;
+   }
+}
+
+symbol_table::slot* symbol_table::probe(uint32_t id) {
+   const symbol_table* self = this;
+   return const_cast<slot*>(self->probe(id));
+}
+
+void symbol_table::grow() {
+   decltype(slots) old(slots.size() * 2, {NONE, NONE},
+                       slots.get_allocator());
+   old.swap(slots);
+   --shift;
+   for(const slot& entry: old)
+      if(entry.id != NONE)
+         *probe(entry.id) = entry;
+}
+
+symbol_node* symbol_table::find(const interned* name) const {
+   const slot* entry = probe(name->id);
+   return entry->binding == NONE ? nullptr : log[entry->binding].node;
+}
+
+bool symbol_table::insert(const interned* name, symbol_node* node) {
+   slot* entry = probe(name->id);
+   if(entry->id == NONE){
+      if((keys + 1) * 2 > slots.size()){
+         grow();
+         entry = probe(name->id);
+      }
+      entry->id = name->id;
+      ++keys;
+   }
+
+   uint32_t depth = marks.size();
+   if(entry->binding != NONE && log[entry->binding].depth == depth)
+      return false;
+
+   log.push_back({name, node, entry->binding, depth});
+   entry->binding = log.size() - 1;
+   return true;
+}
+
+void symbol_table::enter() {
+   marks.push_back(log.size());
+}
+
+//Unbinds the names of the innermost scope, newest first, so each
+//slot gets back the binding it had when the scope began.
+void symbol_table::leave() {
+   uint32_t mark = marks.back();
+   marks.pop_back();
+   while(log.size() > mark){
+      const binding& last = log.back();
+      probe(last.name->id)->binding = last.shadowed;
+      log.pop_back();
+   }
+}
+
+const symbol_table::binding* symbol_table::begin() const {
+   return log.data() + (marks.empty() ? 0 : marks.back());
+}
+
+const symbol_table::binding* symbol_table::end() const {
+   return log.data() + log.size();
+}
+
+//Prints the innermost scope of a symbol table to an output file
 void dump_symbol_table(symbol_table* table, FILE* outfile) {
-   vector<pair<string, symbol_node*>> map(table->begin(), table->end());
+   vector<symbol_table::binding> map(table->begin(), table->end());
 
    sort(map.begin(), map.end(), 
-        [](symbol_entry entry1, symbol_entry entry2){
+        [](const symbol_table::binding& entry1,
+           const symbol_table::binding& entry2){
 
-      const location& left = (entry1.second)->lloc;
-      const location& right = (entry2.second)->lloc;
+      const location& left = entry1.node->lloc;
+      const location& right = entry2.node->lloc;
       if(left.filenr != right.filenr)
          return left.filenr < right.filenr;
 
@@ -74,9 +186,9 @@ void dump_symbol_table(symbol_table* table, FILE* outfile) {
       return left.offset < right.offset;
    });
 
-   for(auto i: map){
+   for(auto& i: map){
       fprintf(outfile, "   ");
-      i.second->print(&(i.first), outfile);
+      i.node->print(i.name->c_str(), outfile);
    }
 }
 
@@ -97,42 +209,40 @@ void set(symbol_node* node, attr attribute){
 }
 
 
-//Adds a string, symbol node pair to a symbol table
-void table_insert(const string& s, symbol_node* node, 
-                                   symbol_table* table){
-   auto i = table->find(s);
-   if(i == table->end()){
-      table->insert({s, node});
+//Adds a name, symbol node pair to a symbol table
+void table_insert(const interned* name, symbol_node* node, 
+                                        symbol_table* table){
+   if(table->insert(name, node))
       return;
-   }
 
-   errllocprintf(node->lloc, "duplicate variable %s\n", s.c_str()); 
+   errllocprintf(node->lloc, "duplicate variable %s\n",
+                 name->c_str()); 
 }
 
 //Prints the attributes of a bitset
-void print_attributes(attr_bitset& attributes, const string& name){
+void print_attributes(attr_bitset& attributes, string_view name){
    for(size_t i = 0; i < static_cast<size_t>(attr::BITSET_SIZE); ++i){
       if(attributes.test(i)) {
-         const char* attr_string = attr_to_string(i).c_str();
-         printf(" %s", attr_string);
-         if(!strcmp(attr_string, "struct"))
-             printf(" \"%s\"", name.c_str());
+         outprintf(" %s", attr_names[i]);
+         if(i == static_cast<size_t>(attr::STRUCT))
+             outprintf(" \"%.*s\"", int(name.size()), name.data());
       }
    }
 
-   printf("\n");
+   outprintf("\n");
 }
 
 //Converts an attribute bitset to a string.
 //Based on code provided by Wesley Mackey.
 const string attrs_to_string(const attr_bitset& attributes, 
-                             const string& name){
+                             string_view name){
     string attr_string = "";
     for(size_t i = 0; i < static_cast<size_t>(attr::BITSET_SIZE); ++i){
         if(attributes.test(i)){
-            attr_string += " " + attr_to_string(i);
-            if(attr_to_string(i) == "struct")
-                attr_string += " \"" + name + "\"";
+            attr_string += " ";
+            attr_string += attr_names[i];
+            if(i == static_cast<size_t>(attr::STRUCT))
+                attr_string.append(" \"").append(name).append("\"");
         }
     }
     return attr_string;
@@ -142,21 +252,7 @@ const string attrs_to_string(const attr_bitset& attributes,
 //Returns the basetype of a node in the astree.
 //Used to retrofit the .ast file
 attr get_basetype(const astree* root){
-   const string& basetype = *(root->lexinfo);
-   if(basetype == "int") 
-      return attr::INT;
-
-   else if(basetype == "string")
-      return attr::STRING;
-
-   else if(basetype == "array")
-      return attr::ARRAY;
-
-   else if(basetype == "void") 
-      return attr::VOID;
- 
-   else
-      return attr::STRUCT;
+   return tokens[root->symbol].basetype;
 }
 
 //All test functions check the attributes of an 
@@ -186,8 +282,8 @@ bool is_compatible(const attr_bitset& cmp1, const attr_bitset& cmp2){
    return status; 
 }
 
-bool is_compatible(const vector<symbol_node*>* cmp1, 
-                   const vector<symbol_node*>* cmp2){
+bool is_compatible(const symbol_list* cmp1, 
+                   const symbol_list* cmp2){
 
    if(cmp1->size() != cmp2->size())
       return false;
@@ -201,30 +297,8 @@ bool is_compatible(const vector<symbol_node*>* cmp1,
    return true;
 }
 
-//Compare is used in the c++ sort function
-bool compare(const symbol_entry& cmp1, 
-             const symbol_entry& cmp2){
-
-   const location& left = (cmp1.second)->lloc;
-   const location& right = (cmp2.second)->lloc;
-   return left.linenr < right.linenr;
-}
-
-
-//Checks if a function is in the symbol table.
-symbol_node* check_function(const string& name, symbol_table* table){
-   auto type = table->find(name);
-   if(type != table->end())
-      return type->second;
-
-   return nullptr;
-}
-
 //Creates a symbol_generator object without an output file.
-symbol_generator::symbol_generator(){
-   structure = new symbol_table();
-   global = new symbol_table();
-   local = global;
+symbol_generator::symbol_generator(): structure(&pool), names(&pool){
    block_nr = 0;
    next_block = 0;
    func_node = nullptr;
@@ -232,10 +306,8 @@ symbol_generator::symbol_generator(){
 }
 
 //Creates a symbol generattor object with a file.
-symbol_generator::symbol_generator(FILE* file){
-   structure = new symbol_table();
-   global = new symbol_table();
-   local = global;
+symbol_generator::symbol_generator(FILE* file):
+                  structure(&pool), names(&pool){
    block_nr = 0;
    next_block = 0;
    func_node = nullptr;
@@ -243,15 +315,39 @@ symbol_generator::symbol_generator(FILE* file){
 }
 
 
-//Performs type checking on the abstract syntax tree
+//Performs type checking on the abstract syntax tree, checking
+//children before their parents.  The field name under an arrow
+//is not checked as a variable.  Blocks and declarations met on the
+//way are handed back to the generator, which gives a block its
+//own scope.
+struct type_checker: visitor<type_checker> {
+   symbol_generator& generator;
+   explicit type_checker(symbol_generator& generator_):
+                         generator(generator_) {
+   }
+   bool pre(token<TOK_FIELD>, astree*, int) { return false; }
+   void post(token<TOK_FIELD>, astree*) {}
+   bool pre(token<TOK_BLOCK>, astree* node, int) {
+      generator.define_block(node);
+      return false;
+   }
+   void post(token<TOK_BLOCK>, astree*) {}
+   bool pre(token<TOK_VARDECL>, astree* node, int) {
+      generator.define_local(node, 0);
+      return false;
+   }
+   void post(token<TOK_VARDECL>, astree*) {}
+   void post_node(astree* node) { generator.type_check_node(node); }
+};
+
 void symbol_generator::type_check(astree* root) {
-   const char* token = parser::get_tname (root->symbol);
-   types type = type_name_hash(token);
+   type_checker checker(*this);
+   visit(root, checker);
+}
 
-   if(strcmp(token, "TOK_ARROW") && root->children.size()) {
-      for(auto child : root->children)
-         type_check(child);
-   }
+//Type checks one node whose children have been checked
+void symbol_generator::type_check_node(astree* root) {
+   types type = tokens[root->symbol].type;
 
     root->block_nr = block_nr;
     astree* left = nullptr;
@@ -288,11 +384,11 @@ void symbol_generator::type_check(astree* root) {
       if(left->symbol_item == nullptr)
          break;
 
-      vector<symbol_node*>* params = left->symbol_item->parameters;
+      symbol_list* params = left->symbol_item->parameters;
       if(params->size() == root->children.size() - 1){
-         auto i = root->children.begin() + 1;
+         auto i = ++root->children.begin();
          auto j = params->begin();
-         for(; i < root->children.end(); ++i, ++j){
+         for(; i != root->children.end(); ++i, ++j){
             if(is_compatible((*i)->attributes, (*j)->attributes))
                continue;
 
@@ -331,28 +427,26 @@ void symbol_generator::type_check(astree* root) {
       break;
 
    case types::FIELD:{
-      type_check(left);
       if(left->symbol_item == nullptr)
          break;
 
       if(left->symbol_item->fields == nullptr)
          break;
 
-      auto i = left->symbol_item->fields->find(*(right->lexinfo)); 
-      if(i != left->symbol_item->fields->end()){
+      symbol_node* field = left->symbol_item->fields->find(
+                           right->lexinfo); 
+      if(field != nullptr){
          set(root, attr::VADDR);
          set(root, attr::LVAL);
-         set(root, i->second->attributes);
+         set(root, field->attributes);
          break;
       }
 
       const astree* l = left;
-      symbol_node* r = i->second;
       errllocprintf(root->lloc, "undefined field \n\t%s\n", 
                    (attrs_to_string(l->attributes, 
                    l->symbol_item ? l->symbol_item->type_name : "") 
-                   + "\n\t" + attrs_to_string(r->attributes, 
-                   r->type_name)).c_str());
+                   + "\n\t" + right->lexinfo->str()).c_str());
 
       break;
    }
@@ -451,12 +545,12 @@ void symbol_generator::type_check(astree* root) {
 
 //Checks if a struct is in the symbol table
 symbol_node* symbol_generator::check_struct(astree* root){
-   auto type = structure->find(*(root->lexinfo));
+   symbol_node* type = structure.find(root->lexinfo);
    
-   if(type != structure->end()){
-      root->symbol_item = type->second;
-      root->attributes = type->second->attributes;
-      return type->second;
+   if(type != nullptr){
+      root->symbol_item = type;
+      root->attributes = type->attributes;
+      return type;
    }
     
    errllocprintf(root->lloc, "undefined type: %s\n",
@@ -465,16 +559,15 @@ symbol_node* symbol_generator::check_struct(astree* root){
    return nullptr;    
 }
 
-//Checks if a variable is in the symbol tables
+//Checks if a variable is in scope, finding its innermost
+//declaration in one probe
 symbol_node* symbol_generator::check_var(astree* root){
-   auto type = local->find(*(root->lexinfo));
-   if(type == local->end())
-      type = global->find(*(root->lexinfo));
+   symbol_node* type = names.find(root->lexinfo);
 
-   if(type != global->end()){
-      root->symbol_item = type->second;
-      root->attributes = type->second->attributes;
-      return type->second;
+   if(type != nullptr){
+      root->symbol_item = type;
+      root->attributes = type->attributes;
+      return type;
    }
     
    errllocprintf(root->lloc, "undefined variable: %s\n",
@@ -497,7 +590,7 @@ symbol_node* symbol_generator::ident_decl(astree* root,
    if(root->children.size() > 1)
       right = root->children[1];
 
-   symbol_node* symbol = new symbol_node(root->lloc, root->block_nr);
+   symbol_node* symbol = new_node(root->lloc, root->block_nr);
 
    attr basetype = get_basetype(root);
    set(symbol, basetype);
@@ -566,26 +659,49 @@ symbol_node* symbol_generator::ident_decl(astree* root,
    var->symbol_item = symbol;
    var->attributes = symbol->attributes;
 
-   table_insert(*(var->lexinfo), symbol, table);
+   table_insert(var->lexinfo, symbol, table);
 
    return symbol;
 }
 
 //Creates a basic symbol node object
 symbol_node::symbol_node(location l, size_t nr){
-    attributes = *(new attr_bitset());
     sequence = 0;
     fields = nullptr;
     lloc = l;
     block_nr = nr;
     parameters = nullptr;
-    type_name = "";
+}
+
+//Nodes, tables and lists live in the pool, and are released with
+//it, never destroyed one by one.  The tables and lists keep their
+//storage in the pool too, so skipping their destructors leaks
+//nothing.
+static_assert(is_trivially_destructible<symbol_node>::value,
+              "symbol nodes are released with their pool");
+
+symbol_node* symbol_generator::new_node(location lloc, size_t nr){
+   void* memory = pool.allocate(sizeof(symbol_node),
+                                alignof(symbol_node));
+   return new(memory) symbol_node(lloc, nr);
+}
+
+symbol_table* symbol_generator::new_table(){
+   void* memory = pool.allocate(sizeof(symbol_table),
+                                alignof(symbol_table));
+   return new(memory) symbol_table(&pool);
+}
+
+symbol_list* symbol_generator::new_list(){
+   void* memory = pool.allocate(sizeof(symbol_list),
+                                alignof(symbol_list));
+   return new(memory) symbol_list(arena_allocator<symbol_node*>(&pool));
 }
 
 //Prints a symbol node
-void symbol_node::print(const string* name, FILE* outfile) {
-    fprintf(outfile, "%s (%zd.%zd.%zd) {%zd} %s",
-            name->c_str(), lloc.filenr, lloc.linenr, lloc.offset,
+void symbol_node::print(const char* name, FILE* outfile) {
+    fprintf(outfile, "%s (%u.%u.%u) {%zd} %s",
+            name, lloc.filenr, lloc.linenr, lloc.offset,
             block_nr, attrs_to_string(attributes, type_name).c_str());
 
     if(sequence != NO_SEQ)
@@ -594,179 +710,222 @@ void symbol_node::print(const string* name, FILE* outfile) {
     fprintf(outfile, "\n");
 }
 
-//Handles functions during traversal
-void symbol_generator::func_stmt(astree* root, symbol_table* table){
-   int size = root->children.size();
-   for(int i = 0; i < size; ++i) {
-      astree* child = root->children[i];
-      astree* left = nullptr;
-      astree* right = nullptr;
-      if(child->children.size())
-         left = child->children[0];
+//Checks the statements of a block in the current scope, numbering
+//its declarations by their place in the block
+void symbol_generator::block_stmt(astree* root){
+   int i = 0;
+   for(auto j = root->children.begin();
+            j != root->children.end(); ++j, ++i) {
+      astree* child = *j;
+      child->block_nr = block_nr;
 
-      if(child->children.size() > 1)
-         right = child->children[1];
+      if(child->symbol == TOK_VARDECL)
+         define_local(child, i);
 
-      child->block_nr = block_nr;
+      else
+         type_check(child);
+   }
+}
 
-      const char* token = parser::get_tname (child->symbol);
+//Checks a block nested in a function in a scope of its own
+void symbol_generator::define_block(astree* root){
+   size_t outer = block_nr;
+   root->block_nr = outer;
+   block_nr = next_block++;
+   names.enter();
+   block_stmt(root);
+   dump_symbol_table(&names, outfile);
+   names.leave();
+   block_nr = outer;
+}
 
-      if(!strcmp(token, "TOK_VARDECL")){
-         type_check(right);
-         symbol_node* var = ident_decl(left, table, "local", i);     
-         if(var != nullptr && !is_compatible(var->attributes, 
-                                             right->attributes)){
-            errllocprintf(root->lloc, "incompatible types for %s\n", 
-                          child->lexinfo->c_str());
+//Enters a local variable once its initializer type checks
+void symbol_generator::define_local(astree* root, size_t seq){
+   astree* left = nullptr;
+   astree* right = nullptr;
+   if(root->children.size())
+      left = root->children[0];
+
+   if(root->children.size() > 1)
+      right = root->children[1];
 
-            print_attributes(var->attributes, var->type_name);
-            string temp = "";
-            if(right->symbol_item != nullptr)
-               temp = right->symbol_item->type_name;
+   root->block_nr = block_nr;
+   type_check(right);
+   symbol_node* var = ident_decl(left, &names, "local", seq);
+   if(var != nullptr && !is_compatible(var->attributes, 
+                                       right->attributes)){
+      errllocprintf(root->lloc, "incompatible types for %s\n", 
+                    root->lexinfo->c_str());
 
-            print_attributes(right->attributes, temp);
-         }
-      }
+      print_attributes(var->attributes, var->type_name);
+      string temp = "";
+      if(right->symbol_item != nullptr)
+         temp = right->symbol_item->type_name;
 
-      else
-         type_check(child);
+      print_attributes(right->attributes, temp);
    }
 }
 
-//Performs a post order traversal of the syntax tree and
-//preforms type checking. Main function of the symbol_table file
+//Builds the symbol tables of a program and type checks it, one
+//declaration under the TOK_ROOT at a time. Main function of the
+//symbol_table file
 void symbol_generator::traverse(astree* root){
+   table_builder builder(*this);
+   visit(root, builder);
+}
+
+//Enters a function, then its parameters and locals in a scope of
+//their own, and checks its body against its prototype
+void symbol_generator::define_function(astree* root){
    astree* left = nullptr;
    astree* right = nullptr;
    if(root->children.size())
       left = root->children[0];
 
    if(root->children.size() > 1)
-      right = root->children[1];  
-
-   const char* token = parser::get_tname(root->symbol); 
+      right = root->children[1];
 
-   if (!strcmp(token, "TOK_FUNCTION")){
-      vector<symbol_node*>* parameters = new vector<symbol_node*>();
-      symbol_table* table = new symbol_table();
-      local = table;
+   astree* function = left->children.back();
+   symbol_node* prototype = names.find(function->lexinfo);
+   bool declared = prototype != nullptr;
+   if(!declared)
+      prototype = ident_decl(left, &names, "func", NO_SEQ);
 
-      block_nr = next_block++;
-      int j = 0;
-      for(auto i = right->children.begin();
-               i != right->children.end(); ++i, ++j){
+   if(prototype == nullptr)
+      return;
 
-         symbol_node* param = ident_decl(*i, table, "param", j);
-         if(param != nullptr)
-            parameters->push_back(param);
-      }
+   symbol_list* parameters = new_list();
+   names.enter();
 
-      astree* function = *(left->children.end() - 1);
-      symbol_node* prototype = check_function(*(function->lexinfo),
-      global);
-      if(prototype == nullptr){
-         symbol_node* func = ident_decl(left, global, "func", NO_SEQ);
-         if(func != nullptr) {
-            func->parameters = parameters;
-            prototype = func;
-         }
-      }
+   block_nr = next_block++;
+   int j = 0;
+   for(auto i = right->children.begin();
+            i != right->children.end(); ++i, ++j){
 
-      else if(!is_compatible(parameters, prototype->parameters)){
-         errllocprintf(root->lloc, 
-                       "incompatible function prototypetype %s\n", 
-                       function->lexinfo->c_str());
-         return;
-      }
+      symbol_node* param = ident_decl(*i, &names, "param", j);
+      if(param != nullptr)
+         parameters->push_back(param);
+   }
 
-      func_node = prototype;
-      func_node->print(function->lexinfo, outfile);
-      func_stmt(root->children[2], table);
+   if(!declared)
+      prototype->parameters = parameters;
 
-      dump_symbol_table(local, outfile);
-      local = global;
+   else if(!is_compatible(parameters, prototype->parameters)){
+      errllocprintf(root->lloc, 
+                    "incompatible function prototypetype %s\n", 
+                    function->lexinfo->c_str());
+      names.leave();
+      return;
    }
 
-   else if(!strcmp(token, "TOK_PROTOTYPE")){
-      symbol_node* func = ident_decl(left, global, "func", NO_SEQ);
-      if(func != nullptr){
-         astree* function = *(left->children.end() - 1);
-         func->print(function->lexinfo, outfile);
-         func->parameters = new vector<symbol_node*>();
-         symbol_table* table = new symbol_table();
-         local = table;
+   func_node = prototype;
+   func_node->print(function->lexinfo->c_str(), outfile);
+   block_stmt(root->children[2]);
 
-         block_nr = next_block++;
-         int j = 0;
-         for(auto i = right->children.begin();
-                  i != right->children.end(); ++i, ++j){
+   dump_symbol_table(&names, outfile);
+   names.leave();
+}
 
-            symbol_node* param = ident_decl(*i, table, "param", j);
-            if(param != nullptr)  
-               func->parameters->push_back(param);
-         }
+//Enters a prototype and its parameters
+void symbol_generator::define_prototype(astree* root){
+   astree* left = nullptr;
+   astree* right = nullptr;
+   if(root->children.size())
+      left = root->children[0];
 
-         dump_symbol_table(local, outfile);
-         local = global;
-      }
+   if(root->children.size() > 1)
+      right = root->children[1];
 
-   }
-   
-   else if (!strcmp(token, "TOK_STRUCT")){
-      block_nr = 0;
-      symbol_table* table = new symbol_table();
-      symbol_node* node = new symbol_node(left->lloc, 0);
-      set(node, attr::STRUCT);
-      set(node, attr::TYPEID);
-      node->fields = table;
-      node->type_name = *(left->lexinfo);
-      node->sequence = NO_SEQ;
-      table_insert(*(left->lexinfo), node, structure);
-      node->print(left->lexinfo, outfile);
-      left->symbol_item = node;
-      left->attributes = node->attributes;
+   symbol_node* func = ident_decl(left, &names, "func", NO_SEQ);
+   if(func != nullptr){
+      astree* function = left->children.back();
+      func->print(function->lexinfo->c_str(), outfile);
+      func->parameters = new_list();
+      names.enter();
 
+      block_nr = next_block++;
       int j = 0;
       for(auto i = right->children.begin();
-               i != right->children.end(); ++i, ++j)
+               i != right->children.end(); ++i, ++j){
 
-         ident_decl(*i, table, "field", j);
+         symbol_node* param = ident_decl(*i, &names, "param", j);
+         if(param != nullptr)  
+            func->parameters->push_back(param);
+      }
 
-      dump_symbol_table(table, outfile); 
+      dump_symbol_table(&names, outfile);
+      names.leave();
    }
+}
 
-   else if(!strcmp(token, "TOK_VARDECL")){
-      type_check(right);
-      symbol_node* var = ident_decl(left, global, "ident", NO_SEQ);
-      if(var == nullptr){
-         ;; //do nothing
-      }
+//Enters a struct and its fields
+void symbol_generator::define_struct(astree* root){
+   astree* left = nullptr;
+   astree* right = nullptr;
+   if(root->children.size())
+      left = root->children[0];
 
-      else if(is_compatible(var->attributes, right->attributes)){
-         astree* decl_name = *(left->children.end() - 1);
-         var->print(decl_name->lexinfo, outfile);
-      }
+   if(root->children.size() > 1)
+      right = root->children[1];
 
-      else{
-         errllocprintf(root->lloc, "incompatible types for %s\n", 
-                       root->lexinfo->c_str());
+   block_nr = 0;
+   symbol_table* table = new_table();
+   symbol_node* node = new_node(left->lloc, 0);
+   set(node, attr::STRUCT);
+   set(node, attr::TYPEID);
+   node->fields = table;
+   node->type_name = left->lexinfo->view();
+   node->sequence = NO_SEQ;
+   table_insert(left->lexinfo, node, &structure);
+   node->print(left->lexinfo->c_str(), outfile);
+   left->symbol_item = node;
+   left->attributes = node->attributes;
+
+   int j = 0;
+   for(auto i = right->children.begin();
+            i != right->children.end(); ++i, ++j)
+
+      ident_decl(*i, table, "field", j);
+
+   dump_symbol_table(table, outfile);
+}
 
-         print_attributes(var->attributes, var->type_name);
-         string temp = "";
-         if(right->symbol_item != nullptr)
-            temp = right->symbol_item->type_name;
-         print_attributes(right->attributes, temp);
-      }
+//Enters a global variable once its initializer type checks
+void symbol_generator::define_global(astree* root){
+   astree* left = nullptr;
+   astree* right = nullptr;
+   if(root->children.size())
+      left = root->children[0];
+
+   if(root->children.size() > 1)
+      right = root->children[1];
+
+   type_check(right);
+   symbol_node* var = ident_decl(left, &names, "ident", NO_SEQ);
+   if(var == nullptr){
+      ;; //do nothing
    }
 
-   else if(!strcmp(token, "TOK_ROOT")){
-      for(auto i = root->children.begin();
-               i != root->children.end(); ++i){
-         traverse(*i);
-      }
+   else if(is_compatible(var->attributes, right->attributes)){
+      astree* decl_name = left->children.back();
+      var->print(decl_name->lexinfo->c_str(), outfile);
    }
 
-   else
-      errllocprintf(root->lloc, "symbol_generate: invalid: %s\n", 
+   else{
+      errllocprintf(root->lloc, "incompatible types for %s\n", 
                     root->lexinfo->c_str());
+
+      print_attributes(var->attributes, var->type_name);
+      string temp = "";
+      if(right->symbol_item != nullptr)
+         temp = right->symbol_item->type_name;
+      print_attributes(right->attributes, temp);
+   }
+}
+
+//Anything else under the root is not a declaration
+bool table_builder::pre_node(astree* root, int){
+   errllocprintf(root->lloc, "symbol_generate: invalid: %s\n", 
+                 root->lexinfo->c_str());
+   return false;
 }
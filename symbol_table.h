@@ -4,10 +4,14 @@
 #include <bitset>
 #include <iostream>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
+#include <stdint.h>
+
+#include "arena.h"
 #include "auxlib.h"
+#include "string_set.h"
 
 struct astree;
 
@@ -17,10 +21,62 @@ enum class attr {
 };
 using attr_bitset = bitset<unsigned(attr::BITSET_SIZE)>;
 
+//Names of the attributes as printed, indexed by attr.
+inline constexpr const char* attr_names[] {
+   "void", "int", "null", "string", "struct", "array", "function",
+   "variable", "field", "typeid", "param", "local", "lval", "const",
+   "vreg", "vaddr",
+};
+static_assert(size(attr_names) == size_t(attr::BITSET_SIZE),
+              "one name per attribute");
+
 struct symbol_node;
 
-using symbol_table = unordered_map<string, symbol_node*>;
-using symbol_entry = symbol_table::value_type;
+using symbol_list = vector<symbol_node*, arena_allocator<symbol_node*>>;
+
+//Symbols by interned name, in nested scopes.  The innermost
+//binding of a name is found by probing an open addressed table
+//keyed by its id.  Bindings go on an undo log, each with the one
+//it shadows, and leaving a scope pops its bindings off the log,
+//restoring what they shadowed.  Ids stay in the table once seen,
+//so probes never cross a deleted slot.  A table given an arena
+//keeps its storage there, and need not be destroyed.
+struct symbol_table {
+   static constexpr uint32_t NONE = UINT32_MAX;
+   struct binding {
+      const interned* name;
+      symbol_node* node;
+      uint32_t shadowed;        // binding of name further out
+      uint32_t depth;
+   };
+
+   explicit symbol_table(arena* pool = nullptr);
+   symbol_node* find(const interned* name) const;
+   // The innermost binding of name, or nullptr.
+   bool insert(const interned* name, symbol_node* node);
+   // Binds name in the innermost scope, unless it is bound there.
+   void enter();
+   void leave();
+   size_t depth() const { return marks.size(); }
+   const binding* begin() const;
+   const binding* end() const;
+   // The bindings of the innermost scope, in the order made.
+
+   private:
+   struct slot {
+      uint32_t id;              // NONE if empty
+      uint32_t binding;         // index in log, or NONE
+   };
+   vector<slot, arena_allocator<slot>> slots;
+   vector<binding, arena_allocator<binding>> log;
+   vector<uint32_t, arena_allocator<uint32_t>> marks;
+   // log size as each scope began
+   uint32_t shift;
+   size_t keys;
+   const slot* probe(uint32_t id) const;
+   slot* probe(uint32_t id);
+   void grow();
+};
 
 struct symbol_node {
    attr_bitset attributes;
@@ -28,12 +84,11 @@ struct symbol_node {
    symbol_table* fields;
    location lloc;
    size_t block_nr;
-   vector<symbol_node*>* parameters;
-   string type_name;
+   symbol_list* parameters;
+   string_view type_name;       // an interned struct name
 
    symbol_node(location lloc, size_t nr);
-   symbol_node();
-   void print(const string* name, FILE* file);
+   void print(const char* name, FILE* file);
 };
 
 enum class types {
@@ -42,10 +97,12 @@ enum class types {
    VARDECL, NOMATTER
 };
 
+//The tables, symbols and parameter lists of a compilation are kept
+//in its generator's pool, and released with the generator.
 struct symbol_generator {
-   symbol_table* structure;
-   symbol_table* global;
-   symbol_table* local;
+   arena pool;
+   symbol_table structure;
+   symbol_table names;          // globals, then nested blocks
    symbol_node* func_node;
    size_t block_nr;
    size_t next_block;
@@ -53,16 +110,28 @@ struct symbol_generator {
 
    symbol_generator(FILE* file);
    symbol_generator();
+   symbol_node* new_node(location lloc, size_t nr);
+   symbol_table* new_table();
+   symbol_list* new_list();
    void traverse(astree* root);
+   void define_function(astree* root);
+   void define_prototype(astree* root);
+   void define_struct(astree* root);
+   void define_global(astree* root);
+   void define_block(astree* root);
+   void define_local(astree* root, size_t seq);
    void type_check(astree* root);
-   void func_stmt(astree* root, symbol_table* table);
+   void type_check_node(astree* root);
+   void block_stmt(astree* root);
    symbol_node* check_struct(astree* root);
    symbol_node* check_var(astree* root);
    symbol_node* ident_decl(astree* root, symbol_table* table,
                             const string& decl_type, size_t seq = 0); 
 };
 
-void dump_symbol_table(symbol_table* table);
+void dump_symbol_table(symbol_table* table, FILE* outfile);
+void table_insert(const interned* name, symbol_node* node,
+                  symbol_table* table);
 void type_check(const astree* root, types type);
 void set(astree* root, attr attri);
 void set(astree* root, const attr_bitset& attris);
@@ -72,6 +141,6 @@ bool test(const astree* root, attr attri);
 bool test(const attr_bitset& attrs, attr attri);
 attr get_basetype(const astree* root);
 const string attrs_to_string(const attr_bitset& attrs,
-                             const string& name);
+                             string_view name);
 
 #endif
@@ -0,0 +1,88 @@
+#include "thread_pool.h"
+
+//Starts nthreads workers, each with its own empty queue.
+thread_pool::thread_pool (size_t nthreads):
+             pending(0), next_queue(0), stopping(false) {
+   if (nthreads == 0) nthreads = 1;
+   for (size_t i = 0; i < nthreads; ++i) {
+      queues.push_back (make_unique<work_queue>());
+   }
+   for (size_t i = 0; i < nthreads; ++i) {
+      workers.emplace_back (&thread_pool::run, this, i);
+   }
+}
+
+//Drains the remaining work, then joins the workers.
+thread_pool::~thread_pool() {
+   wait();
+   {
+      lock_guard<mutex> guard (idle_lock);
+      stopping = true;
+   }
+   idle_cond.notify_all();
+   for (thread& worker: workers) worker.join();
+}
+
+size_t thread_pool::default_threads() {
+   size_t nthreads = thread::hardware_concurrency();
+   return nthreads == 0 ? 1 : nthreads;
+}
+
+void thread_pool::submit (task work) {
+   size_t index = next_queue++ % queues.size();
+   {
+      lock_guard<mutex> guard (idle_lock);
+      ++pending;
+   }
+   {
+      lock_guard<mutex> guard (queues[index]->lock);
+      queues[index]->tasks.push_back (move (work));
+   }
+   idle_cond.notify_one();
+}
+
+void thread_pool::wait() {
+   unique_lock<mutex> guard (idle_lock);
+   done_cond.wait (guard, [this] { return pending == 0; });
+}
+
+//Takes the oldest task from the worker's own queue.
+bool thread_pool::pop_front (size_t self, task& work) {
+   work_queue& queue = *queues[self];
+   lock_guard<mutex> guard (queue.lock);
+   if (queue.tasks.empty()) return false;
+   work = move (queue.tasks.front());
+   queue.tasks.pop_front();
+   return true;
+}
+
+//Takes the newest task from some other worker's queue.
+bool thread_pool::steal (size_t self, task& work) {
+   for (size_t i = 1; i < queues.size(); ++i) {
+      work_queue& victim = *queues[(self + i) % queues.size()];
+      lock_guard<mutex> guard (victim.lock);
+      if (victim.tasks.empty()) continue;
+      work = move (victim.tasks.back());
+      victim.tasks.pop_back();
+      return true;
+   }
+   return false;
+}
+
+void thread_pool::run (size_t self) {
+   // Idle workers poll with a timeout so that a task pushed between
+   // the queue scan and the wait is never missed for long.
+   for(;;) {
+      task work;
+      if (pop_front (self, work) or steal (self, work)) {
+         work();
+         lock_guard<mutex> guard (idle_lock);
+         if (--pending == 0) done_cond.notify_all();
+         continue;
+      }
+      unique_lock<mutex> guard (idle_lock);
+      if (stopping) return;
+      idle_cond.wait_for (guard, chrono::milliseconds (10));
+   }
+}
+
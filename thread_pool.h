@@ -0,0 +1,56 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+//
+// DESCRIPTION
+//    Work-stealing thread pool.  Each worker owns a deque of tasks.
+//    A worker takes work from the front of its own deque and, when
+//    that is empty, steals from the back of another worker's deque.
+//
+
+struct thread_pool {
+   using task = function<void()>;
+
+   struct work_queue {
+      mutex lock;
+      deque<task> tasks;
+   };
+
+   vector<unique_ptr<work_queue>> queues;
+   vector<thread> workers;
+   mutex idle_lock;
+   condition_variable idle_cond;
+   condition_variable done_cond;
+   size_t pending;             // guarded by idle_lock
+   atomic<size_t> next_queue;
+   bool stopping;
+
+   thread_pool (size_t nthreads);
+   ~thread_pool();
+   void submit (task work);
+   // Queues a task, distributing round-robin over the workers.
+
+   void wait();
+   // Blocks until every submitted task has finished.
+
+   static size_t default_threads();
+   // Number of hardware threads, or 1 if that is unknown.
+
+   private:
+   bool pop_front (size_t self, task& work);
+   bool steal (size_t self, task& work);
+   void run (size_t self);
+};
+
+#endif
+
@@ -0,0 +1,35 @@
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <stdio.h>
+#include <string.h>
+
+#include "astree.h"
+#include "lyutils.h"
+#include "string_set.h"
+#include "token_log.h"
+
+void token_log::append (int symbol, const location& lloc,
+                        const interned* lexinfo) {
+   records.push_back ({symbol, static_cast<uint32_t> (lloc.filenr),
+                       static_cast<uint32_t> (lloc.linenr),
+                       static_cast<uint32_t> (lloc.offset),
+                       lexinfo->id});
+}
+
+void token_log::print (FILE* tok_file) const {
+   for (const record& token: records) {
+      const char* tname = parser::get_tname (token.symbol);
+      if (strstr (tname, "TOK_") == tname) tname += 4;
+      fprintf (tok_file, " %4u   %-6.3f  %-3d  %-10s  %-s\n",
+               token.filenr, token.linenr + token.offset / 1.0000,
+               token.symbol, tname,
+               string_set::lookup (token.lexinfo)->c_str());
+   }
+}
+
+void token_log::clear() {
+   vector<record>().swap (records);
+}
+
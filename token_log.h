@@ -0,0 +1,47 @@
+#ifndef __TOKEN_LOG_H__
+#define __TOKEN_LOG_H__
+
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <stdint.h>
+#include <stdio.h>
+
+struct interned;
+struct location;
+
+//
+// DESCRIPTION
+//    The tokens of a compilation in the order they were scanned,
+//    appended by lexer::token.  A record is 20 bytes: the symbol,
+//    the location packed into 32-bit fields, and the id of the
+//    interned lexinfo, which outlives the tree.  The .tok file is
+//    formatted from the log in one pass, and tokens the parser
+//    discarded are in it too.  Tools may read the tokens here
+//    without parsing.
+//
+
+struct token_log {
+   struct record {
+      int32_t symbol;
+      uint32_t filenr;
+      uint32_t linenr;
+      uint32_t offset;
+      uint32_t lexinfo;       // id from string_set::intern
+   };
+
+   vector<record> records;
+
+   void append (int symbol, const location& lloc,
+                const interned* lexinfo);
+
+   void print (FILE* tok_file) const;
+   // Writes one .tok line for each record.
+
+   void clear();
+   // Forgets the records and frees their memory.
+};
+
+#endif
+
@@ -0,0 +1,198 @@
+#ifndef __VISITOR_H__
+#define __VISITOR_H__
+
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+using namespace std;
+
+#include <stdio.h>
+
+#include "astree.h"
+#include "lyutils.h"
+
+//
+// DESCRIPTION
+//    Passes over the syntax tree as visitors.  A visitor derives
+//    from visitor<itself> and defines handlers: pre (token<SYM>,
+//    node, depth) and post (token<SYM>, node) for the tokens it
+//    treats specially, and pre_node (node, depth) and post_node
+//    (node) for the rest.  Which handler a token gets is settled
+//    when the visitor is compiled, by a switch over every token in
+//    yytokens.h.  pre handlers run before a node's children and
+//    return false to skip them; post handlers run after.
+//
+//    visit (tree, visitors...) walks tree once for all of the
+//    visitors, calling each in the order given at every node.  A
+//    visitor that skips a node's children does not see them, but
+//    the walk still descends for the others, so passes fused in
+//    one walk see what they would see walked one by one.
+//
+
+template <int symbol>
+struct token {
+};
+
+template <typename derived>
+struct visitor {
+   bool pre_node (astree*, int) { return true; }
+   void post_node (astree*) {}
+   bool enter (astree* node, int depth);
+   void leave (astree* node);
+
+   private:
+   template <typename visitor_t, int symbol, typename = void>
+   struct has_pre: false_type {};
+   template <typename visitor_t, int symbol>
+   struct has_pre<visitor_t, symbol, void_t<decltype (
+          declval<visitor_t&>().pre (token<symbol>(), nullptr, 0))>>:
+          true_type {};
+   template <typename visitor_t, int symbol, typename = void>
+   struct has_post: false_type {};
+   template <typename visitor_t, int symbol>
+   struct has_post<visitor_t, symbol, void_t<decltype (
+          declval<visitor_t&>().post (token<symbol>(), nullptr))>>:
+          true_type {};
+   derived& self() { return static_cast<derived&> (*this); }
+   template <int symbol> bool enter_token (astree* node, int depth);
+   template <int symbol> void leave_token (astree* node);
+};
+
+template <typename derived>
+template <int symbol>
+bool visitor<derived>::enter_token (astree* node, int depth) {
+   if constexpr (has_pre<derived, symbol>::value) {
+      return self().pre (token<symbol>(), node, depth);
+   }else {
+      return self().pre_node (node, depth);
+   }
+}
+
+template <typename derived>
+template <int symbol>
+void visitor<derived>::leave_token (astree* node) {
+   if constexpr (has_post<derived, symbol>::value) {
+      self().post (token<symbol>(), node);
+   }else {
+      self().post_node (node);
+   }
+}
+
+template <typename derived>
+bool visitor<derived>::enter (astree* node, int depth) {
+   switch (node->symbol) {
+#define TOKEN(name) \
+      case name: return enter_token<name> (node, depth);
+#include "yytokens.h"
+#undef TOKEN
+      default: return self().pre_node (node, depth);
+   }
+}
+
+template <typename derived>
+void visitor<derived>::leave (astree* node) {
+   switch (node->symbol) {
+#define TOKEN(name) \
+      case name: leave_token<name> (node); break;
+#include "yytokens.h"
+#undef TOKEN
+      default: self().post_node (node); break;
+   }
+}
+
+//Several visitors walked as one.  skipping holds, for each, the
+//node whose children it declined, until that node is left.
+template <typename... visitor_t>
+struct fused {
+   tuple<visitor_t&...> visitors;
+   array<astree*, sizeof... (visitor_t)> skipping {};
+
+   fused (visitor_t&... visitors_): visitors (visitors_...) {}
+   bool enter (astree* node, int depth) {
+      return enter_all (node, depth,
+                        index_sequence_for<visitor_t...>());
+   }
+   void leave (astree* node) {
+      leave_all (node, index_sequence_for<visitor_t...>());
+   }
+
+   private:
+   template <size_t which> bool enter_one (astree* node, int depth) {
+      if (skipping[which] != nullptr) return false;
+      if (get<which> (visitors).enter (node, depth)) return true;
+      skipping[which] = node;
+      return false;
+   }
+   template <size_t which> void leave_one (astree* node) {
+      if (skipping[which] == node) skipping[which] = nullptr;
+      else if (skipping[which] != nullptr) return;
+      get<which> (visitors).leave (node);
+   }
+   template <size_t... which>
+   bool enter_all (astree* node, int depth, index_sequence<which...>) {
+      bool descend = false;
+      ((descend = enter_one<which> (node, depth) or descend), ...);
+      return descend;
+   }
+   template <size_t... which>
+   void leave_all (astree* node, index_sequence<which...>) {
+      (leave_one<which> (node), ...);
+   }
+};
+
+template <typename visitor_t>
+void visit (astree* tree, visitor_t& pass) {
+   astree::walk (tree, [&pass] (astree* node, int depth) {
+      return pass.enter (node, depth);
+   }, [&pass] (astree* node) {
+      pass.leave (node);
+   });
+}
+
+template <typename visitor_t, typename... more_t>
+void visit (astree* tree, visitor_t& first, more_t&... more) {
+   fused<visitor_t, more_t...> visitors (first, more...);
+   visit (tree, visitors);
+}
+
+//Writes the .ast form of a tree, indented depth levels.
+struct ast_printer: visitor<ast_printer> {
+   FILE* outfile;
+   int depth;
+   ast_printer (FILE* outfile_, int depth_ = 0):
+                outfile (outfile_), depth (depth_) {
+   }
+   bool pre_node (astree* node, int level);
+};
+
+//Enters the declarations under a TOK_ROOT into the tables of a
+//symbol_generator, writing them to its .sym file.
+struct table_builder: visitor<table_builder> {
+   symbol_generator& generator;
+   explicit table_builder (symbol_generator& generator_):
+                           generator (generator_) {
+   }
+   bool pre (token<TOK_ROOT>, astree*, int) { return true; }
+   bool pre (token<TOK_FUNCTION>, astree* node, int) {
+      generator.define_function (node);
+      return false;
+   }
+   bool pre (token<TOK_PROTOTYPE>, astree* node, int) {
+      generator.define_prototype (node);
+      return false;
+   }
+   bool pre (token<TOK_STRUCT>, astree* node, int) {
+      generator.define_struct (node);
+      return false;
+   }
+   bool pre (token<TOK_VARDECL>, astree* node, int) {
+      generator.define_global (node);
+      return false;
+   }
+   bool pre_node (astree* node, int depth);
+};
+
+#endif
+